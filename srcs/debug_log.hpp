@@ -1,16 +1,11 @@
 #pragma once
 
+/* Free-form debug messages, compiled in with -DDEBUG only.
+ * They go to std::clog so they never mix with program output; per-instruction
+ * events are traced with AVM_TRACE (trace/Trace.hpp) instead.
+ */
 #ifdef DEBUG
-  #define LOG(msg) do { std::cout << msg << std::endl; } while(0)
+  #define LOG(msg) do { std::clog << msg << '\n'; } while(0)
 #else
   #define LOG(msg) do {} while(0)
 #endif
-
-#ifdef DEBUG
-  #define LOG_OP(op, line) \
-    std::cout << "[VM] " << op << " (line " << line << ")" << std::endl
-#else
-  #define LOG_OP(op, line) do {} while(0)
-#endif
-
-
@@ -0,0 +1,81 @@
+#include "Error.hpp"
+#include "Exception.hpp"
+
+void Error::m_appendText(std::string& out) const
+{
+    for (const char* p = _desc->text; *p; ++p)
+    {
+        if (p[0] == '%' && p[1] == 's')
+        {
+            out += _detail;
+            ++p;
+        }
+        else if (p[0] == '%' && p[1] == 'l')
+        {
+            out += std::to_string(_line);
+            ++p;
+        }
+        else
+            out += *p;
+    }
+}
+
+void Error::appendTo(std::string& out) const
+{
+    switch (_desc->kind)
+    {
+        case ErrorKind::Lexical:
+            out += "Lexical error at line " + std::to_string(_line) + ", col " + std::to_string(_col) + ": ";
+            break;
+        case ErrorKind::Syntax:
+            out += "Syntax error at line " + std::to_string(_line);
+            if (_col)
+                out += ", col " + std::to_string(_col);
+            out += ": ";
+            break;
+        case ErrorKind::StackUnderflow:
+            out += "Stack underflow at line " + std::to_string(_line) + ": ";
+            break;
+        case ErrorKind::Assertion:
+            out += "Assertion failed at line " + std::to_string(_line) + ": ";
+            break;
+        case ErrorKind::FailedToOpenFile:
+            out += "Failed to open file: ";
+            break;
+        default:
+            break;
+    }
+    m_appendText(out);
+}
+
+std::string Error::message() const
+{
+    std::string out;
+    appendTo(out);
+    return out;
+}
+
+void Error::raise() const
+{
+    std::string text;
+    m_appendText(text);
+
+    switch (_desc->kind)
+    {
+        case ErrorKind::Lexical: throw LexicalError(_line, _col, text);
+        case ErrorKind::Syntax:
+            if (_col)
+                throw SyntaxError(_line, _col, text);
+            throw SyntaxError(_line, text);
+        case ErrorKind::StackUnderflow: throw StackUnderflow(_line, text);
+        case ErrorKind::Assertion: throw AssertionFailed(_line, text);
+        case ErrorKind::DivisionByZero: throw DivisionByZero(text);
+        case ErrorKind::Overflow: throw OverflowException(text);
+        case ErrorKind::Underflow: throw UnderflowException(text);
+        case ErrorKind::InvalidValue: throw InvalidValue(text);
+        case ErrorKind::InvalidOperandType: throw InvalidOperandType(text);
+        case ErrorKind::UnknownOperation: throw UnknownOperation(text);
+        case ErrorKind::FailedToOpenFile: throw FailedToOpenFile(text);
+    }
+    throw InvalidValue(text);
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+
+/* Exception-free error channel for the lex/parse/execute hot paths.
+ * An Error points at a static descriptor and carries only the line, column
+ * and detail its message needs; the text is formatted when reported, so a
+ * failing line costs about as much as a succeeding one. raise() turns it
+ * into the matching AVMException for callers that want exceptions.
+ */
+enum class ErrorKind { Lexical, Syntax, StackUnderflow, Assertion, DivisionByZero, Overflow, Underflow,
+                       InvalidValue, InvalidOperandType, UnknownOperation, FailedToOpenFile };
+
+/* `text` is the message after the kind's usual prefix ("Syntax error at
+ * line N, col C: ", ...); "%s" expands to the detail, "%l" to the line. */
+struct ErrorDesc
+{
+    ErrorKind kind;
+    const char* text;
+};
+
+class Error
+{
+    private:
+        const ErrorDesc* _desc;
+        int _line;
+        int _col;
+        std::string _detail;
+
+        void m_appendText(std::string& out) const;
+
+    public:
+        /* A default Error means success. */
+        Error() : _desc(nullptr), _line(0), _col(0) {}
+        Error(const ErrorDesc& desc, int line, int col = 0, std::string_view detail = {})
+            : _desc(&desc), _line(line), _col(col), _detail(detail) {}
+
+        bool failed() const { return _desc != nullptr; }
+        ErrorKind kind() const { return _desc->kind; }
+
+        /* Same text as what() of the exception raise() would throw. */
+        void appendTo(std::string& out) const;
+        std::string message() const;
+        [[noreturn]] void raise() const;
+};
+
+/* Either a T or the Error that prevented it (std::expected, pre-C++23). */
+template <typename T>
+class Expected
+{
+    private:
+        std::variant<T, Error> _v;
+
+    public:
+        Expected(T value) : _v(std::in_place_index<0>, std::move(value)) {}
+        Expected(Error error) : _v(std::in_place_index<1>, std::move(error)) {}
+
+        bool has_value() const { return _v.index() == 0; }
+        explicit operator bool() const { return has_value(); }
+        T& value() { return *std::get_if<0>(&_v); }
+        const T& value() const { return *std::get_if<0>(&_v); }
+        T& operator*() { return value(); }
+        T* operator->() { return &value(); }
+        const Error& error() const { return *std::get_if<1>(&_v); }
+
+        /* The API-boundary accessor: throws instead of returning an Error. */
+        T valueOrRaise()
+        {
+            if (!has_value())
+                error().raise();
+            return std::move(value());
+        }
+};
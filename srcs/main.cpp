@@ -1,10 +1,25 @@
 #include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
 #include <fstream>
 #include <memory>
 #include "operand/Operand.hpp"
 #include "parser/InputReader.hpp"
 #include "parser/Lexer.hpp"
 #include "parser/Parser.hpp"
+#include "vm/Program.hpp"
+#include "vm/CompileCache.hpp"
+#include "vm/MappedFile.hpp"
+#include "vm/Runner.hpp"
+#include "vm/Checkpoint.hpp"
+#include "vm/Watcher.hpp"
+#include "vm/RowRunner.hpp"
+#include "vm/SegmentRunner.hpp"
+#include "vm/Session.hpp"
+#include "profiler/Profiler.hpp"
+#include "stats/MemStats.hpp"
+#include "trace/Trace.hpp"
 #include "debug_log.hpp"
 
 #if !defined(TEST_OPERAND_MAIN)
@@ -14,6 +29,7 @@ namespace
 {
 
     constexpr size_t kBatchSize = 10000;
+    constexpr size_t kMaxPendingErrors = 64 * 1024;
 
     void printLine(const Line& line)
     {
@@ -24,80 +40,476 @@ namespace
     #endif
     }
 
-    std::unique_ptr<inputReader> makeInput(int argc, char** argv)
+    struct Options
     {
-        const bool isStdin = (argc == 1);
-        const std::string filename = isStdin ? "stdin" : argv[1];
-        return std::make_unique<inputReader>(filename, isStdin);
-    }
+        std::string inputFile;      /* empty means stdin */
+        bool continueOnError = false;
+        std::string profileFile;    /* --profile <file> */
+        bool memStats = false;      /* --mem-stats */
+        std::string traceFile;      /* --trace <file> */
+        size_t loadLimitMiB = 0;    /* --load-limit <MiB>, 0 keeps the default */
+        size_t stackBudgetMiB = 0;  /* --stack-mem-budget <MiB>: spill older stack chunks, 0 never */
+        std::string rowsFile;       /* --rows <csv>: run the program once per row */
+        unsigned jobs = 0;          /* --jobs <n>, 0 uses every core */
+        bool sessions = false;      /* --sessions: interleave every positional program */
+        size_t slice = 1000;        /* --slice <n>: instructions per session turn */
+        std::vector<std::string> sessionFiles;
+        bool stream = false;        /* --stream: execute each line as it arrives */
+        bool checked = false;       /* --checked: integer over/underflow is an error */
+        bool lazy = false;          /* --lazy: compute values only once observed */
+        size_t checkpointEvery = 0; /* --checkpoint-every <n>: snapshot to <input>.ckpt */
+        std::string resumeFile;     /* --resume <snapshot> */
+        bool watch = false;         /* --watch: re-run the file from its first edited line */
+        std::string cacheDir;       /* --cache <dir>: reuse compiled programs */
+        size_t cacheMiB = 0;        /* --cache-size <MiB>, 0 keeps the default */
+        bool parallelSegments = false;  /* --parallel-segments: run independent stretches on every core */
+    };
 
-    bool processLine(vm& virtualMachine, const Line& line)
+    /* Prints the memory report on every exit path out of main. */
+    struct MemStatsReport
     {
-        printLine(line);
+        bool enabled;
+        ~MemStatsReport()
+        {
+            if (enabled)
+                MemStats::report(std::cerr);
+        }
+    };
 
-        std::vector<Token> tokens = Lexer::tokenize(line);
-        Instruction instr = Parser::parseInstruction(tokens);
+    /* Flushes and closes the trace file on every exit path out of main. */
+    struct TraceGuard
+    {
+        ~TraceGuard()
+        {
+            Tracer::stop();
+        }
+    };
 
-        if (instr.op == OpCode::None)
-            return false;
+    bool parseArgs(int argc, char** argv, Options& opts)
+    {
+        std::vector<std::string> positional;
 
-        if (instr.op == OpCode::Exit)
+        for (int i = 1; i < argc; ++i)
         {
-            LOG("Exit instruction encountered. Exiting.");
-            return true;
+            std::string arg = argv[i];
+            if (arg == "--profile")
+            {
+                if (i + 1 >= argc)
+                    return false;
+                opts.profileFile = argv[++i];
+            }
+            else if (arg == "--mem-stats")
+                opts.memStats = true;
+            else if (arg == "--trace")
+            {
+                if (i + 1 >= argc)
+                    return false;
+                opts.traceFile = argv[++i];
+            }
+            else if (arg == "--load-limit")
+            {
+                if (i + 1 >= argc)
+                    return false;
+                opts.loadLimitMiB = std::strtoull(argv[++i], nullptr, 10);
+                if (opts.loadLimitMiB == 0)
+                    return false;
+            }
+            else if (arg == "--stack-mem-budget")
+            {
+                if (i + 1 >= argc)
+                    return false;
+                opts.stackBudgetMiB = std::strtoull(argv[++i], nullptr, 10);
+                if (opts.stackBudgetMiB == 0)
+                    return false;
+            }
+            else if (arg == "--rows")
+            {
+                if (i + 1 >= argc)
+                    return false;
+                opts.rowsFile = argv[++i];
+            }
+            else if (arg == "--jobs")
+            {
+                if (i + 1 >= argc)
+                    return false;
+                opts.jobs = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+            }
+            else if (arg == "--stream")
+                opts.stream = true;
+            else if (arg == "--checked")
+                opts.checked = true;
+            else if (arg == "--lazy")
+                opts.lazy = true;
+            else if (arg == "--checkpoint-every")
+            {
+                if (i + 1 >= argc)
+                    return false;
+                opts.checkpointEvery = std::strtoull(argv[++i], nullptr, 10);
+                if (opts.checkpointEvery == 0)
+                    return false;
+            }
+            else if (arg == "--resume")
+            {
+                if (i + 1 >= argc)
+                    return false;
+                opts.resumeFile = argv[++i];
+            }
+            else if (arg == "--watch")
+                opts.watch = true;
+            else if (arg == "--cache")
+            {
+                if (i + 1 >= argc)
+                    return false;
+                opts.cacheDir = argv[++i];
+            }
+            else if (arg == "--cache-size")
+            {
+                if (i + 1 >= argc)
+                    return false;
+                opts.cacheMiB = std::strtoull(argv[++i], nullptr, 10);
+                if (opts.cacheMiB == 0)
+                    return false;
+            }
+            else if (arg == "--parallel-segments")
+                opts.parallelSegments = true;
+            else if (arg == "--sessions")
+                opts.sessions = true;
+            else if (arg == "--slice")
+            {
+                if (i + 1 >= argc)
+                    return false;
+                opts.slice = std::strtoull(argv[++i], nullptr, 10);
+                if (opts.slice == 0)
+                    return false;
+            }
+            else
+                positional.push_back(arg);
+        }
+
+        /* Sessions, rows and watch runs make vms of their own. */
+        if ((opts.stackBudgetMiB || opts.lazy) && (opts.sessions || opts.watch || !opts.rowsFile.empty()))
+            return false;
+        /* The profiler follows one current line for the whole process. */
+        if (!opts.profileFile.empty() && (opts.sessions || !opts.rowsFile.empty()))
+            return false;
+        /* A snapshot saves the stack as it is, without deferred values. */
+        if (opts.lazy && opts.checkpointEvery)
+            return false;
+        if (opts.sessions)
+        {
+            opts.sessionFiles = positional;
+            return !positional.empty();
         }
+        if (positional.size() > 2)
+            return false;
+        if (positional.size() > 0)
+            opts.inputFile = positional[0];
+        opts.continueOnError = (positional.size() > 1);
+        /* Snapshots record input offsets, so they need a file to seek in. */
+        if ((opts.checkpointEvery || !opts.resumeFile.empty()) && (opts.inputFile.empty() || !opts.rowsFile.empty()))
+            return false;
+        if (opts.watch && (opts.inputFile.empty() || opts.continueOnError || opts.stream || !opts.rowsFile.empty()
+                           || opts.checkpointEvery || !opts.resumeFile.empty()))
+            return false;
+        /* Cache entries are keyed on a file's contents and hold whole programs. */
+        if (!opts.cacheDir.empty() && (opts.inputFile.empty() || opts.stream || opts.watch || opts.checkpointEvery
+                                       || !opts.resumeFile.empty()))
+            return false;
+        /* Segments are found in a compiled program; they run out of order
+         * on vms of their own, which neither the profiler's current line
+         * nor the trace's thread and depth can follow. */
+        if (opts.parallelSegments && (opts.inputFile.empty() || opts.stream || opts.watch || opts.checkpointEvery
+                                      || !opts.resumeFile.empty() || !opts.rowsFile.empty()
+                                      || !opts.profileFile.empty() || !opts.traceFile.empty()))
+            return false;
+        return true;
+    }
+
+    std::unique_ptr<inputReader> makeInput(const Options& opts)
+    {
+        const bool isStdin = opts.inputFile.empty();
+        const std::string filename = isStdin ? "stdin" : opts.inputFile;
+        return std::make_unique<inputReader>(filename, isStdin);
+    }
+
+    /* Appends one line to the program and runs as far as it can: to the
+     * end, or to a jump whose label or loop end is on a line not read yet.
+     * Errors come back as a value so continue-on-error mode can report
+     * them and carry on. */
+    Error processLine(Assembler& code, Runner& runner, Checkpoint& checkpoint, vm& virtualMachine, const Line& line)
+    {
+        printLine(line);
+        Profiler::setLine(static_cast<int>(line.no));
+        code.append(line);
+        return checkpoint.run(runner, code, virtualMachine, line);
+    }
 
-        virtualMachine.executeInstruction(instr);
-        return false;
+    /* Checkpoints need a seekable input, so stdin has none. */
+    uint64_t inputSize(const Options& opts)
+    {
+        return opts.inputFile.empty() ? 0 : std::filesystem::file_size(opts.inputFile);
     }
 
-    bool runProgram(inputReader& input, vm& virtualMachine)
+    /* Sets up --checkpoint-every and --resume for a line-by-line run. */
+    std::unique_ptr<Checkpoint> startCheckpoints(const Options& opts, inputReader& input, Assembler& code,
+                                                 Runner& runner, vm& virtualMachine)
     {
-        for (size_t linesRead = input.readProgram(kBatchSize); linesRead > 0; linesRead = input.readProgram(kBatchSize))
+        std::unique_ptr<Checkpoint> checkpoint
+            = std::make_unique<Checkpoint>(opts.inputFile, opts.checkpointEvery, inputSize(opts));
+
+        if (!opts.resumeFile.empty())
+            checkpoint->resume(opts.resumeFile, input, code, runner, virtualMachine);
+        return checkpoint;
+    }
+
+    /* In stream mode only one line is read ahead and output is flushed
+     * after every line, so interactive producers see results at once.
+     * Executed lines are discarded between batches unless a jump may
+     * still return to them, so the code held stays bounded only until
+     * the first label: every line from there on is kept. */
+    bool runProgram(inputReader& input, vm& virtualMachine, const Options& opts)
+    {
+        const size_t batch = opts.stream ? 1 : kBatchSize;
+        Assembler code;
+        Runner runner(virtualMachine, code);
+        std::unique_ptr<Checkpoint> checkpoint = startCheckpoints(opts, input, code, runner, virtualMachine);
+
+        for (size_t linesRead = input.readProgram(batch); linesRead > 0; linesRead = input.readProgram(batch))
         {
             LOG("Read " << linesRead << " lines from input.");
+            code.discardBefore(runner.keepFrom());
 
             for (Line line = input.getLine(); line.no != 0; line = input.getLine())
             {
-                if (processLine(virtualMachine, line))
+                Error err = processLine(code, runner, *checkpoint, virtualMachine, line);
+                if (err.failed())
+                    err.raise();
+                if (opts.stream)
+                    std::cout.flush();
+                if (virtualMachine.halted())
                     return true;
             }
 
             LOG("End of lines.");
         }
-        return false;
+        code.close();
+        Error err = runner.run();
+        if (err.failed())
+            err.raise();
+        return virtualMachine.halted();
+    }
+
+    /* Every failing instruction is reported and skipped; the next one runs
+     * on the stack as it was before the failure. Messages are collected
+     * and written to stderr once per batch, or sooner if a loop keeps
+     * failing. */
+    bool runProgramErrors(inputReader& input, vm& virtualMachine, const Options& opts)
+    {
+        const size_t batch = opts.stream ? 1 : kBatchSize;
+        std::ofstream devnull("/dev/null");
+        std::streambuf* coutbuf = std::cout.rdbuf();
+        std::string errors;
+        Assembler code;
+        Runner runner(virtualMachine, code);
+        std::unique_ptr<Checkpoint> checkpoint = startCheckpoints(opts, input, code, runner, virtualMachine);
+        std::cout.rdbuf(devnull.rdbuf());
+
+        auto report = [&](Error err) {
+            for (; err.failed(); err = runner.run())
+            {
+                err.appendTo(errors);
+                errors += '\n';
+                if (errors.size() > kMaxPendingErrors)
+                {
+                    std::cerr << errors;
+                    errors.clear();
+                }
+            }
+        };
+        for (size_t linesRead = input.readProgram(batch); linesRead > 0 && !virtualMachine.halted();
+             linesRead = input.readProgram(batch))
+        {
+            LOG("Read " << linesRead << " lines from input.");
+            code.discardBefore(runner.keepFrom());
+
+            for (Line line = input.getLine(); line.no != 0 && !virtualMachine.halted(); line = input.getLine())
+                report(processLine(code, runner, *checkpoint, virtualMachine, line));
+            std::cerr << errors;
+            errors.clear();
+
+            LOG("End of lines.");
+        }
+        if (!virtualMachine.halted())
+        {
+            code.close();
+            report(runner.run());
+            std::cerr << errors;
+        }
+        std::cout.rdbuf(coutbuf);
+        return virtualMachine.halted();
+    }
+
+    /* Compiles the input, or with --cache loads it from there when the
+     * file is unchanged since it was stored. A miss compiles the mapped
+     * bytes the key was computed from rather than `input`, so an entry
+     * always holds the text it is stored under. */
+    std::unique_ptr<Program> compile(inputReader& input, const Options& opts)
+    {
+        std::unique_ptr<Program> program = std::make_unique<Program>();
+        if (opts.cacheDir.empty())
+        {
+            program->compile(input);
+            return program;
+        }
+
+        MappedFile source(opts.inputFile, SIZE_MAX);
+        CompileCache cache(opts.cacheDir, opts.cacheMiB ? uint64_t(opts.cacheMiB) << 20 : CompileCache::kDefaultMaxBytes);
+        const Hash128 key = CompileCache::key(source.data(), source.size());
+        if (cache.load(key, *program))
+            return program;
+        program = std::make_unique<Program>();
+        inputReader mapped(source.data(), source.size());
+        program->compile(mapped);
+        cache.store(key, *program);
+        return program;
     }
 
-    bool runProgramErrors(inputReader& input, vm& virtualMachine)
+    /* --cache and --parallel-segments run the compiled program, which
+     * prints and fails exactly as the line-by-line run does. A program with
+     * a lexical or syntax error before its exit is not compiled and runs
+     * line by line, so the lines before the error still execute first.
+     * Segments need a program without control flow; any other runs on one
+     * core. */
+    bool runCompiled(vm& virtualMachine, const Options& opts)
     {
+        std::unique_ptr<Program> program;
+        try
+        {
+            inputReader input(opts.inputFile, false);
+            program = compile(input, opts);
+        }
+        catch (const LexicalError&)
+        {
+        }
+        catch (const SyntaxError&)
+        {
+        }
+        if (!program)
+        {
+            std::unique_ptr<inputReader> input = makeInput(opts);
+            if (opts.continueOnError)
+                return runProgramErrors(*input, virtualMachine, opts);
+            return runProgram(*input, virtualMachine, opts);
+        }
+
+        Runner runner(virtualMachine, program->code());
+        std::unique_ptr<SegmentRunner> segments;
+        if (opts.parallelSegments && SegmentRunner::straightLine(program->code()))
+            segments = std::make_unique<SegmentRunner>(virtualMachine, program->code(), opts.jobs);
+        auto run = [&] { return segments ? segments->run() : runner.run(); };
+        if (!opts.continueOnError)
+        {
+            Error err = run();
+            if (err.failed())
+                err.raise();
+            return virtualMachine.halted();
+        }
+
         std::ofstream devnull("/dev/null");
         std::streambuf* coutbuf = std::cout.rdbuf();
+        std::string errors;
         std::cout.rdbuf(devnull.rdbuf());
+        for (Error err = run(); err.failed(); err = run())
+        {
+            err.appendTo(errors);
+            errors += '\n';
+            if (errors.size() > kMaxPendingErrors)
+            {
+                std::cerr << errors;
+                errors.clear();
+            }
+        }
+        std::cerr << errors;
+        std::cout.rdbuf(coutbuf);
+        return virtualMachine.halted();
+    }
+
+    /* Compiles the whole program once, then runs it for every row of
+     * --rows in parallel. Outputs are printed in row order; each failed
+     * row is reported on stderr with its row number. */
+    int runRows(inputReader& input, const Options& opts)
+    {
+        std::unique_ptr<Program> program = compile(input, opts);
 
-        for (size_t linesRead = input.readProgram(kBatchSize); linesRead > 0; linesRead = input.readProgram(kBatchSize))
+        std::vector<std::string> rows = RowRunner::readRows(opts.rowsFile);
+        std::vector<RowResult> results = RowRunner::run(*program, rows, opts.jobs, opts.loadLimitMiB << 20, opts.checked);
+        int status = 0;
+
+        for (size_t i = 0; i < results.size(); ++i)
         {
-            try
+            std::cout << results[i].output;
+            if (!results[i].error.empty())
             {
-                LOG("Read " << linesRead << " lines from input.");
+                std::cout.flush();
+                std::cerr << "Row " << i + 1 << ": " << results[i].error << "\n";
+                status = 1;
+            }
+        }
+        return status;
+    }
+
+    /* Runs every --sessions program on this one thread through the
+     * coroutine Scheduler, feeding each a chunk of its file per round as if
+     * input were trickling in. Outputs are printed per program in argument
+     * order once all sessions are done. */
+    int runSessions(const Options& opts)
+    {
+        constexpr size_t kLinesPerRound = 256;
+        std::vector<std::string> outputs(opts.sessionFiles.size());
+        std::vector<std::unique_ptr<std::ifstream>> files;
+        std::vector<Session*> sessions;
+        Scheduler scheduler([&](Session& s, const std::string& out) {
+            outputs[std::find(sessions.begin(), sessions.end(), &s) - sessions.begin()] += out;
+        }, opts.slice, opts.checked);
+
+        for (const std::string& path : opts.sessionFiles)
+        {
+            files.push_back(std::make_unique<std::ifstream>(path));
+            if (!files.back()->is_open())
+                throw FailedToOpenFile(path);
+            sessions.push_back(&scheduler.add(path));
+        }
 
-                for (Line line = input.getLine(); line.no != 0; line = input.getLine())
+        do
+        {
+            for (size_t i = 0; i < sessions.size(); ++i)
+            {
+                if (!sessions[i]->waitingForInput())
+                    continue;
+                std::string line;
+                size_t fed = 0;
+                while (fed < kLinesPerRound && std::getline(*files[i], line))
                 {
-                    if (processLine(virtualMachine, line))
-                    {
-                        std::cout.rdbuf(coutbuf);
-                        return true;
-                    }
+                    scheduler.feed(*sessions[i], line);
+                    fed++;
                 }
-
-                LOG("End of lines.");
+                if (fed < kLinesPerRound)
+                    scheduler.close(*sessions[i]);
             }
-            catch(const std::exception& e)
+        } while (scheduler.run() > 0);
+
+        int status = 0;
+        for (size_t i = 0; i < sessions.size(); ++i)
+        {
+            std::cout << outputs[i];
+            if (!sessions[i]->ok())
             {
-                std::cerr << e.what() << '\n';
+                std::cout.flush();
+                std::cerr << sessions[i]->name() << ": " << sessions[i]->error() << "\n";
+                status = 1;
             }
         }
-        std::cout.rdbuf(coutbuf);
-        return false;
+        return status;
     }
 
     int reportAndFail(const char* prefix, const std::exception& e)
@@ -113,22 +525,50 @@ namespace
 int main(int argc, char** argv)
 {
     vm virtualMachine;
+    Options opts;
     bool sawExit;
     
     LOG("Hello, Abstract VM!");
-    if (argc > 3)
+    if (!parseArgs(argc, argv, opts))
     {
-        std::cerr << "Usage: " << argv[0] << " [input_file] [continue-on-error]\n";
+        std::cerr << "Usage: " << argv[0] << " [--profile <out.folded>] [--mem-stats] [--stream] [--checked] [--lazy] [--checkpoint-every <n>] [--resume <snapshot>] [--watch] [--cache <dir> [--cache-size <MiB>]] [--trace <file>] [--load-limit <MiB>] [--stack-mem-budget <MiB>] [--rows <csv>] [--parallel-segments] [--jobs <n>] [--sessions [--slice <n>] <file>...] [input_file] [continue-on-error]\n";
         return 1;
     }
 
+    if (opts.memStats)
+        MemStats::enable();
+    if (opts.loadLimitMiB)
+        virtualMachine.setLoadLimit(opts.loadLimitMiB << 20);
+    if (opts.stackBudgetMiB)
+        virtualMachine.setStackMemoryBudget(opts.stackBudgetMiB << 20);
+    virtualMachine.setCheckedArithmetic(opts.checked);
+    virtualMachine.setLazy(opts.lazy);
+    virtualMachine.setJobs(opts.jobs);
+    MemStatsReport memReport{opts.memStats};
+    TraceGuard traceGuard;
+
     try
     {
-        std::unique_ptr<inputReader> input = makeInput(argc, argv);
-        if (argc > 2)
-            sawExit = runProgramErrors(*input, virtualMachine);
+        if (!opts.traceFile.empty())
+            Tracer::start(opts.traceFile);
+        std::unique_ptr<Profiler> profiler;
+        if (!opts.profileFile.empty())
+            profiler = std::make_unique<Profiler>(opts.profileFile, opts.inputFile.empty() ? "stdin" : opts.inputFile);
+        if (opts.sessions)
+            return runSessions(opts);
+
+        if (opts.watch)
+            return Watcher(opts.inputFile, opts.checked, opts.loadLimitMiB << 20).watch();
+
+        std::unique_ptr<inputReader> input = makeInput(opts);
+        if (!opts.rowsFile.empty())
+            return runRows(*input, opts);
+        if (!opts.cacheDir.empty() || opts.parallelSegments)
+            sawExit = runCompiled(virtualMachine, opts);
+        else if (opts.continueOnError)
+            sawExit = runProgramErrors(*input, virtualMachine, opts);
         else
-            sawExit = runProgram(*input, virtualMachine);
+            sawExit = runProgram(*input, virtualMachine, opts);
 
         if (!sawExit)
         {
@@ -0,0 +1,235 @@
+#pragma once
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include "OperandValue.hpp"
+#include "../exception/Exception.hpp"
+
+/* Native arithmetic on (type, value) pairs, with the same semantics as
+ * Operand<T>::operate: the result takes the type of higher precision, the
+ * lhs is converted with a plain cast and integers wrap in the result type.
+ * Besides + - * / % the operators '<' (min) and '>' (max) pick one side
+ * after the same promotion, for the reduction instructions.
+ */
+namespace arith
+{
+    inline eOperandType promote(eOperandType lhs, eOperandType rhs)
+    {
+        return (lhs >= rhs) ? lhs : rhs;
+    }
+
+    /* Operand::makeOp converts the rhs through its canonical string, which
+     * is exact for every pair but Float -> Double: there the 9-digit text
+     * is re-read as a double. Reproduce that so results stay byte-identical. */
+    template <typename R>
+    inline R convertRhs(eOperandType type, OperandValue v)
+    {
+        if constexpr (std::is_same<R, double>::value)
+        {
+            if (type == Float)
+            {
+                char buf[kMaxValueChars + 1];
+                buf[formatValue(buf, Float, v)] = '\0';
+                return std::strtod(buf, nullptr);
+            }
+        }
+
+        switch (type)
+        {
+            case Float: return static_cast<R>(v.f);
+            case Double: return static_cast<R>(v.d);
+            default: return static_cast<R>(v.i);
+        }
+    }
+
+    template <typename R>
+    inline R convertLhs(eOperandType type, OperandValue v)
+    {
+        switch (type)
+        {
+            case Float: return static_cast<R>(v.f);
+            case Double: return static_cast<R>(v.d);
+            default: return static_cast<R>(v.i);
+        }
+    }
+
+    template <typename R>
+    inline OperandValue compute(char op, R lhs, R rhs)
+    {
+        if ((op == '/' || op == '%') && rhs == static_cast<R>(0))
+            throw DivisionByZero("Error: Division by zero");
+
+        if constexpr (std::is_floating_point<R>::value)
+        {
+            switch (op)
+            {
+                case '+': return makeValue<R>(lhs + rhs);
+                case '-': return makeValue<R>(lhs - rhs);
+                case '*': return makeValue<R>(lhs * rhs);
+                case '/': return makeValue<R>(lhs / rhs);
+                case '%': return makeValue<R>(static_cast<R>(std::fmod(lhs, rhs)));
+                case '<': return makeValue<R>(lhs < rhs ? lhs : rhs);
+                case '>': return makeValue<R>(lhs > rhs ? lhs : rhs);
+            }
+        }
+        else
+        {
+            /* Computed in 64 bits and truncated: the same wrap-around as
+             * narrow arithmetic, without signed-overflow UB (INT32_MIN / -1). */
+            int64_t l = lhs;
+            int64_t r = rhs;
+            switch (op)
+            {
+                case '+': return makeValue<R>(static_cast<R>(static_cast<uint64_t>(l) + static_cast<uint64_t>(r)));
+                case '-': return makeValue<R>(static_cast<R>(static_cast<uint64_t>(l) - static_cast<uint64_t>(r)));
+                case '*': return makeValue<R>(static_cast<R>(static_cast<uint64_t>(l) * static_cast<uint64_t>(r)));
+                case '/': return makeValue<R>(static_cast<R>(l / r));
+                case '%': return makeValue<R>(static_cast<R>(l % r));
+                case '<': return makeValue<R>(lhs < rhs ? lhs : rhs);
+                case '>': return makeValue<R>(lhs > rhs ? lhs : rhs);
+            }
+        }
+        throw UnknownOperation("Unknown operator in makeOp");
+    }
+
+    /* Checked counterpart of compute() for integer R: 0 when `out` holds
+     * the exact result, 1 if it is above R's range, -1 if below. The
+     * overflow builtins make the in-range case as cheap as compute(). */
+    template <typename R>
+    inline int computeChecked(char op, R lhs, R rhs, OperandValue& out)
+    {
+        static_assert(std::is_integral<R>::value, "checked arithmetic is for integer types");
+        R r;
+        bool wrapped;
+
+        switch (op)
+        {
+            case '+': wrapped = __builtin_add_overflow(lhs, rhs, &r); break;
+            case '-': wrapped = __builtin_sub_overflow(lhs, rhs, &r); break;
+            case '*': wrapped = __builtin_mul_overflow(lhs, rhs, &r); break;
+            case '/':
+                wrapped = (lhs == std::numeric_limits<R>::min() && rhs == -1);
+                r = wrapped ? lhs : static_cast<R>(lhs / rhs);
+                break;
+            default:
+                out = compute<R>(op, lhs, rhs);
+                return 0;
+        }
+        if (__builtin_expect(wrapped, 0))
+        {
+            /* The exact result fits in 64 bits for every 32-bit pair. */
+            int64_t l = lhs;
+            int64_t rr = rhs;
+            int64_t exact = (op == '+') ? l + rr : (op == '-') ? l - rr : (op == '*') ? l * rr : l / rr;
+            return exact > 0 ? 1 : -1;
+        }
+        out = makeValue<R>(r);
+        return 0;
+    }
+
+    /* Whether `lhs op rhs` would throw DivisionByZero. Widening keeps a
+     * value zero or non-zero, so the unconverted rhs can be tested. */
+    inline bool divisorIsZero(char op, eOperandType rt, OperandValue rhs)
+    {
+        if (op != '/' && op != '%')
+            return false;
+        switch (rt)
+        {
+            case Float: return rhs.f == 0.0f;
+            case Double: return rhs.d == 0.0;
+            default: return rhs.i == 0;
+        }
+    }
+
+    template <typename R>
+    inline OperandValue apply(char op, eOperandType lt, OperandValue lhs, eOperandType rt, OperandValue rhs)
+    {
+        return compute<R>(op, convertLhs<R>(lt, lhs), convertRhs<R>(rt, rhs));
+    }
+
+    /* lhs op rhs; `resultType` receives the promoted type. */
+    inline OperandValue apply(char op, eOperandType lt, OperandValue lhs, eOperandType rt, OperandValue rhs,
+                              eOperandType& resultType)
+    {
+        resultType = promote(lt, rt);
+        switch (resultType)
+        {
+            case Int8: return apply<int8_t>(op, lt, lhs, rt, rhs);
+            case Int16: return apply<int16_t>(op, lt, lhs, rt, rhs);
+            case Int32: return apply<int32_t>(op, lt, lhs, rt, rhs);
+            case Float: return apply<float>(op, lt, lhs, rt, rhs);
+            case Double: return apply<double>(op, lt, lhs, rt, rhs);
+            case None: break;
+        }
+        throw InvalidOperandType("Invalid operand type in operation.");
+    }
+
+    /* Operators in dispatch-table order; Min and Max are '<' and '>'. */
+    enum class Op : uint8_t { Add, Sub, Mul, Div, Mod, Min, Max };
+    constexpr size_t kOpCount = 7;
+    constexpr size_t kTypeCount = 5;
+    constexpr char kOpChars[kOpCount] = { '+', '-', '*', '/', '%', '<', '>' };
+
+    inline char opChar(Op op)
+    {
+        return kOpChars[static_cast<size_t>(op)];
+    }
+
+    template <eOperandType E> struct Native;
+    template <> struct Native<Int8> { typedef int8_t type; };
+    template <> struct Native<Int16> { typedef int16_t type; };
+    template <> struct Native<Int32> { typedef int32_t type; };
+    template <> struct Native<Float> { typedef float type; };
+    template <> struct Native<Double> { typedef double type; };
+
+    typedef OperandValue (*Kernel)(OperandValue lhs, OperandValue rhs);
+
+    /* One apply() with lhs type, rhs type and operator fixed at compile
+     * time, so promotion and both switches fold away. Index is
+     * (lhs * kTypeCount + rhs) * kOpCount + op. */
+    template <size_t Index>
+    OperandValue kernel(OperandValue lhs, OperandValue rhs)
+    {
+        constexpr eOperandType L = static_cast<eOperandType>(Index / (kTypeCount * kOpCount));
+        constexpr eOperandType R = static_cast<eOperandType>(Index / kOpCount % kTypeCount);
+        typedef typename Native<(L >= R) ? L : R>::type T;
+
+        return compute<T>(kOpChars[Index % kOpCount], convertLhs<T>(L, lhs), convertRhs<T>(R, rhs));
+    }
+
+    template <size_t... Index>
+    constexpr std::array<Kernel, sizeof...(Index)> makeKernels(std::index_sequence<Index...>)
+    {
+        return {{ &kernel<Index>... }};
+    }
+
+    inline constexpr std::array<Kernel, kTypeCount * kTypeCount * kOpCount> kKernels =
+        makeKernels(std::make_index_sequence<kTypeCount * kTypeCount * kOpCount>());
+
+    /* The kernel for `lt op rt`; its result has type promote(lt, rt). */
+    inline Kernel kernelFor(eOperandType lt, eOperandType rt, Op op)
+    {
+        return kKernels[(static_cast<size_t>(lt) * kTypeCount + rt) * kOpCount + static_cast<size_t>(op)];
+    }
+
+    /* apply() with integer results checked for over/underflow (see
+     * computeChecked); float and double results are never reported. */
+    inline int applyChecked(char op, eOperandType lt, OperandValue lhs, eOperandType rt, OperandValue rhs,
+                            eOperandType& resultType, OperandValue& out)
+    {
+        resultType = promote(lt, rt);
+        switch (resultType)
+        {
+            case Int8: return computeChecked<int8_t>(op, static_cast<int8_t>(lhs.i), static_cast<int8_t>(rhs.i), out);
+            case Int16: return computeChecked<int16_t>(op, static_cast<int16_t>(lhs.i), static_cast<int16_t>(rhs.i), out);
+            case Int32: return computeChecked<int32_t>(op, static_cast<int32_t>(lhs.i), static_cast<int32_t>(rhs.i), out);
+            default:
+                out = apply(op, lt, lhs, rt, rhs, resultType);
+                return 0;
+        }
+    }
+}
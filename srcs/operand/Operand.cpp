@@ -2,88 +2,61 @@
 #include <type_traits>
 #include <iostream>
 #include "Operand.hpp"
+#include "OperandValue.hpp"
+#include "../stats/MemStats.hpp"
 
 /* Private helpers */
 
 template <typename T>
 static std::string m_toCanonicalString(T v, eOperandType type)
 {
-    std::ostringstream oss;
-
-    if (type == Int8 || type == Int16 || type == Int32)
-    {
-        oss << static_cast<long long>(v);
-        return oss.str();
-    }
+    char buf[kMaxValueChars];
+    return std::string(buf, formatValue(buf, type, makeValue<T>(v)));
+}
 
-    if (type == Float)
-    {
-        oss << std::setprecision(std::numeric_limits<float>::max_digits10)
-            << static_cast<float>(v);
-        return oss.str();
-    }
+template <typename U>
+static IOperand const * m_make(OperandValue value, eOperandType type)
+{
+    return new Operand<U>(valueAs<U>(value), type);
+}
 
-    oss << std::setprecision(std::numeric_limits<double>::max_digits10)
-        << static_cast<double>(v);
+/* Both operands go through the arith kernel table: the rhs is read as
+ * its native value (no text round trip) and the result is built from one. */
+template <typename T>
+template <typename U>
+OperandValue Operand<T>::readNative(IOperand const & operand)
+{
+    return makeValue<U>(static_cast<Operand<U> const &>(operand)._value);
+}
 
-    return oss.str();
+template <typename T>
+OperandValue Operand<T>::nativeOf(IOperand const & operand)
+{
+    static OperandValue (*const readers[arith::kTypeCount])(IOperand const &) = {
+        &readNative<int8_t>, &readNative<int16_t>, &readNative<int32_t>, &readNative<float>, &readNative<double>
+    };
+    return readers[operand.getType()](operand);
 }
 
 template <typename T>
-template<typename R>
-IOperand const * Operand<T>::makeOp(IOperand const & rhs, char op, eOperandType type) const
-{
-    R rhsVal;
-    if constexpr (std::is_floating_point<R>::value)
-        rhsVal = static_cast<R>(std::stod(rhs.toString()));
-    else
-    {
-        long double rhsLD = std::stold(rhs.toString());
-        rhsVal = static_cast<R>(rhsLD);
-    }
-
-    if ((op == '/' || op == '%') && rhsVal == static_cast<R>(0))
-        throw DivisionByZero("Error: Division by zero");
-
-    R lhsVal = static_cast<R>(this->_value);
-    R result{};
-    switch (op)
-    {
-        case '+': result = lhsVal + rhsVal; break;
-        case '-': result = lhsVal - rhsVal; break;
-        case '*': result = lhsVal * rhsVal; break;
-        case '/': result = lhsVal / rhsVal; break;
-        case '%':
-            if constexpr (std::is_floating_point<R>::value)
-                result = static_cast<R>(std::fmod(lhsVal, rhsVal));
-            else
-                result = static_cast<R>(lhsVal % rhsVal);
-            break;
-        default:
-            throw UnknownOperation("Unknown operator in makeOp");
-    }
-#ifdef DEBUG
-    std::cout << "Operation: " << lhsVal << " " << op << " " << rhsVal << " = " << result << std::endl;
-#endif
-    return new Operand<R>(result, type);
+IOperand const * Operand<T>::fromNative(eOperandType type, OperandValue value)
+{
+    static IOperand const * (*const makers[arith::kTypeCount])(OperandValue, eOperandType) = {
+        &m_make<int8_t>, &m_make<int16_t>, &m_make<int32_t>, &m_make<float>, &m_make<double>
+    };
+    return makers[type](value, type);
 }
 
 template <typename T>
-IOperand const * Operand<T>::operate(IOperand const & rhs, char op) const
+IOperand const * Operand<T>::operate(IOperand const & rhs, arith::Op op) const
 {
-    eOperandType resultType = (this->getPrecision() >= rhs.getPrecision()) ? this->getType() : rhs.getType();
+    const eOperandType rt = rhs.getType();
+
+    if (_type == None || rt == None)
+        throw InvalidOperandType("Invalid operand type in operation.");
 
-    switch (resultType)
-    {
-        case Int8: return makeOp<int8_t>(rhs, op, Int8);
-        case Int16: return makeOp<int16_t>(rhs, op, Int16);
-        case Int32: return makeOp<int32_t>(rhs, op, Int32);
-        case Float: return makeOp<float>(rhs, op, Float);
-        case Double: return makeOp<double>(rhs, op, Double);
-        case None:
-            throw InvalidOperandType("Invalid operand type in operation.");
-    }
-    throw InvalidOperandType("Invalid operand type in operation.");
+    OperandValue result = arith::kernelFor(_type, rt, op)(makeValue<T>(_value), nativeOf(rhs));
+    return fromNative(arith::promote(_type, rt), result);
 }
 
 /* Actual methods */
@@ -91,6 +64,7 @@ IOperand const * Operand<T>::operate(IOperand const & rhs, char op) const
 template <typename T>
 Operand<T>::Operand(T value, eOperandType type) : _value(value), _type(type), _strValue(m_toCanonicalString(value, type))
 {
+    MemStats::operandCreated();
 #ifdef DEBUG
     std::cout << "Operand created: " << _value << " of type " << typeName(_type) << " string: " << _strValue << std::endl;
 #endif
@@ -99,6 +73,7 @@ Operand<T>::Operand(T value, eOperandType type) : _value(value), _type(type), _s
 template <typename T>
 Operand<T>::~Operand(void)
 {
+    MemStats::operandDestroyed();
 #ifdef DEBUG2
     std::cout << "Operand destroyed: " << _value << " of type " << typeName(_type) << std::endl;
 #endif
@@ -120,31 +95,31 @@ eOperandType Operand<T>::getType(void) const
 template <typename T>
 IOperand const * Operand<T>::operator+(IOperand const & rhs) const
 {
-    return operate(rhs, '+');
+    return operate(rhs, arith::Op::Add);
 }
 
 template <typename T>
 IOperand const * Operand<T>::operator-(IOperand const & rhs) const
 {
-    return operate(rhs, '-');
+    return operate(rhs, arith::Op::Sub);
 }
 
 template <typename T>
 IOperand const * Operand<T>::operator*(IOperand const & rhs) const
 {
-    return operate(rhs, '*');
+    return operate(rhs, arith::Op::Mul);
 }
 
 template <typename T>
 IOperand const * Operand<T>::operator/(IOperand const & rhs) const
 {
-    return operate(rhs, '/');
+    return operate(rhs, arith::Op::Div);
 }
 
 template <typename T>
 IOperand const * Operand<T>::operator%(IOperand const & rhs) const
 {
-    return operate(rhs, '%');
+    return operate(rhs, arith::Op::Mod);
 }
 
 template <typename T>
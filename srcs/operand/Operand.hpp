@@ -7,6 +7,7 @@
 #include <type_traits>
 #include <cassert>
 #include "IOperand.hpp"
+#include "Arithmetic.hpp"
 #include "../exception/Exception.hpp"
 
 template <typename T>
@@ -17,9 +18,13 @@ class Operand : public IOperand
         const eOperandType _type;
         std::string _strValue;
 
-        template<typename R>
-        IOperand const * makeOp(IOperand const & rhs, char op, eOperandType type) const;
-        IOperand const * operate(IOperand const & rhs, char op) const;
+        template <typename> friend class Operand;
+
+        template <typename U>
+        static OperandValue readNative(IOperand const & operand);
+        static OperandValue nativeOf(IOperand const & operand);
+        static IOperand const * fromNative(eOperandType type, OperandValue value);
+        IOperand const * operate(IOperand const & rhs, arith::Op op) const;
 
 
         Operand();
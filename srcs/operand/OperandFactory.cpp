@@ -1,4 +1,5 @@
 #include <cmath>
+#include <cstdlib>
 #include <type_traits>
 #include <iostream>
 #include <charconv>
@@ -10,10 +11,29 @@ OperandFactory::OperandFactory(const OperandFactory& other) { (void)other; }
 const OperandFactory& OperandFactory::operator=(const OperandFactory& other) { (void)other; return *this; }
 OperandFactory::~OperandFactory() {}
 
-static long long parseIntStrict(std::string const& s)
+static const ErrorDesc m_invalidInteger = { ErrorKind::InvalidValue, "Invalid integer literal: %s" };
+static const ErrorDesc m_integerRange = { ErrorKind::InvalidValue, "Integer out of range: %s" };
+static const ErrorDesc m_invalidFloat = { ErrorKind::InvalidValue, "Invalid float literal: %s" };
+static const ErrorDesc m_invalidType = { ErrorKind::InvalidOperandType, "Invalid operand type." };
+static const ErrorDesc m_underflow[5] = {
+    { ErrorKind::Underflow, "Int8 underflow: %s" },
+    { ErrorKind::Underflow, "Int16 underflow: %s" },
+    { ErrorKind::Underflow, "Int32 underflow: %s" },
+    { ErrorKind::Underflow, "Float underflow: %s" },
+    { ErrorKind::Underflow, "Double underflow: %s" }
+};
+static const ErrorDesc m_overflow[5] = {
+    { ErrorKind::Overflow, "Int8 overflow: %s" },
+    { ErrorKind::Overflow, "Int16 overflow: %s" },
+    { ErrorKind::Overflow, "Int32 overflow: %s" },
+    { ErrorKind::Overflow, "Float overflow: %s" },
+    { ErrorKind::Overflow, "Double overflow: %s" }
+};
+
+static Expected<long long> parseIntStrict(std::string const& s)
 {
     if (s.empty())
-        throw InvalidValue("Invalid integer literal: " + s);
+        return Error(m_invalidInteger, 0, 0, s);
 
     long long v = 0;
     auto first = s.data();
@@ -21,22 +41,106 @@ static long long parseIntStrict(std::string const& s)
     auto res = std::from_chars(first, last, v);
 
     if (res.ec == std::errc::result_out_of_range)
-        throw InvalidValue("Integer out of range: " + s);
+        return Error(m_integerRange, 0, 0, s);
     if (res.ec != std::errc() || res.ptr != last)
-        throw InvalidValue("Invalid integer literal: " + s);
+        return Error(m_invalidInteger, 0, 0, s);
 
     return v;
 }
 
-static long double parseFloatStrict(std::string const& s)
+/* Clinger's fast path for the literals the parser accepts, "-?d+.d+":
+ * with at most 19 significant digits and 27 fraction digits the value is
+ * m / 10^k where both are exact in long double, so one correctly rounded
+ * division gives exactly what strtold would. Anything else returns false. */
+static bool m_parseDecimalFast(std::string const& s, long double& out)
 {
-    size_t idx = 0;
-    long double v = std::stold(s, &idx);
-    if (idx != s.size())
-        throw InvalidValue("Invalid float literal: " + s);
+    static constexpr long double kPow10[] = {
+        1e0L, 1e1L, 1e2L, 1e3L, 1e4L, 1e5L, 1e6L, 1e7L, 1e8L, 1e9L, 1e10L, 1e11L, 1e12L, 1e13L,
+        1e14L, 1e15L, 1e16L, 1e17L, 1e18L, 1e19L, 1e20L, 1e21L, 1e22L, 1e23L, 1e24L, 1e25L, 1e26L, 1e27L
+    };
+    /* 10^27 = 2^27 * 5^27 needs 63 mantissa bits; m < 10^19 needs 64. */
+    if constexpr (std::numeric_limits<long double>::digits < 64)
+        return false;
+
+    const char* p = s.data();
+    const char* end = p + s.size();
+    const bool negative = (p < end && *p == '-');
+    uint64_t m = 0;
+    int significant = 0;
+
+    if (negative)
+        ++p;
+    const char* intStart = p;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p)
+    {
+        if (m == 0 && *p == '0')
+            continue;
+        if (++significant > 19)
+            return false;
+        m = m * 10 + static_cast<uint64_t>(*p - '0');
+    }
+    if (p == intStart || p == end || *p != '.')
+        return false;
+    const char* fracStart = ++p;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p)
+    {
+        if (m != 0 || *p != '0')
+            ++significant;
+        if (significant > 19)
+            return false;
+        m = m * 10 + static_cast<uint64_t>(*p - '0');
+    }
+    const long fraction = p - fracStart;
+    if (p != end || fraction == 0 || fraction > 27 || significant > 19)
+        return false;
+
+    long double v = static_cast<long double>(m) / kPow10[fraction];
+    out = negative ? -v : v;
+    return true;
+}
+
+/* strtold rather than std::stold: same conversion, but out-of-range input
+ * yields +-HUGE_VALL (reported as over/underflow below) instead of throwing.
+ * It only runs for literals the fast path above does not take. */
+static Expected<long double> parseFloatStrict(std::string const& s)
+{
+    long double fast;
+    if (m_parseDecimalFast(s, fast))
+        return fast;
+
+    char* end = nullptr;
+    long double v = std::strtold(s.c_str(), &end);
+    if (end == s.c_str() || end != s.c_str() + s.size())
+        return Error(m_invalidFloat, 0, 0, s);
     return v;
 }
 
+template <typename T>
+static Expected<OperandValue> m_parseInt(eOperandType type, std::string const& value)
+{
+    Expected<long long> v = parseIntStrict(value);
+    if (!v)
+        return v.error();
+    if (*v < std::numeric_limits<T>::min())
+        return Error(m_underflow[type], 0, 0, value);
+    if (*v > std::numeric_limits<T>::max())
+        return Error(m_overflow[type], 0, 0, value);
+    return makeValue<T>(static_cast<T>(*v));
+}
+
+template <typename T>
+static Expected<OperandValue> m_parseFloating(eOperandType type, std::string const& value)
+{
+    Expected<long double> v = parseFloatStrict(value);
+    if (!v)
+        return v.error();
+    if (*v < -std::numeric_limits<T>::max())
+        return Error(m_underflow[type], 0, 0, value);
+    if (*v > std::numeric_limits<T>::max())
+        return Error(m_overflow[type], 0, 0, value);
+    return makeValue<T>(static_cast<T>(*v));
+}
+
 IOperand const* OperandFactory::createOperand(eOperandType type, std::string const& value)
 {
     OperandFactory factory;
@@ -54,54 +158,73 @@ IOperand const* OperandFactory::createOperand(eOperandType type, std::string con
     return (factory.*_creators[type])(value);
 }
 
+OperandValue OperandFactory::createValue(eOperandType type, std::string const& value)
+{
+    return tryCreateValue(type, value).valueOrRaise();
+}
+
+Expected<OperandValue> OperandFactory::tryCreateValue(eOperandType type, std::string const& value)
+{
+    static const OperandFactory::ParseFn _parsers[5] = {
+        &OperandFactory::parseInt8,
+        &OperandFactory::parseInt16,
+        &OperandFactory::parseInt32,
+        &OperandFactory::parseFloat,
+        &OperandFactory::parseDouble
+    };
+
+    if (type < Int8 || type > Double) /* cannot happen. */
+        return Error(m_invalidType, 0);
+
+    return _parsers[type](value);
+}
+
+Expected<OperandValue> OperandFactory::parseInt8(std::string const& value)
+{
+    return m_parseInt<int8_t>(Int8, value);
+}
+
+Expected<OperandValue> OperandFactory::parseInt16(std::string const& value)
+{
+    return m_parseInt<int16_t>(Int16, value);
+}
+
+Expected<OperandValue> OperandFactory::parseInt32(std::string const& value)
+{
+    return m_parseInt<int32_t>(Int32, value);
+}
+
+Expected<OperandValue> OperandFactory::parseFloat(std::string const& value)
+{
+    return m_parseFloating<float>(Float, value);
+}
+
+Expected<OperandValue> OperandFactory::parseDouble(std::string const& value)
+{
+    return m_parseFloating<double>(Double, value);
+}
+
 IOperand const* OperandFactory::createInt8(std::string const& value) const
 {
-    long long v = parseIntStrict(value);
-    if (v < std::numeric_limits<int8_t>::min())
-        throw UnderflowException("Int8 underflow: " + value);
-    if (v > std::numeric_limits<int8_t>::max())
-        throw OverflowException("Int8 overflow: " + value);
-    return new Operand<int8_t>(static_cast<int8_t>(v), Int8);
+    return new Operand<int8_t>(valueAs<int8_t>(parseInt8(value).valueOrRaise()), Int8);
 }
 
 IOperand const* OperandFactory::createInt16(std::string const& value) const
 {
-    long long v = parseIntStrict(value);
-    if (v < std::numeric_limits<int16_t>::min())
-        throw UnderflowException("Int16 underflow: " + value);
-    if (v > std::numeric_limits<int16_t>::max())
-        throw OverflowException("Int16 overflow: " + value);
-    return new Operand<int16_t>(static_cast<int16_t>(v), Int16);
-
+    return new Operand<int16_t>(valueAs<int16_t>(parseInt16(value).valueOrRaise()), Int16);
 }
 
 IOperand const* OperandFactory::createInt32(std::string const& value) const
 {
-    long long v = parseIntStrict(value);
-    if (v < std::numeric_limits<int32_t>::min())
-        throw UnderflowException("Int32 underflow: " + value);
-    if (v > std::numeric_limits<int32_t>::max())
-        throw OverflowException("Int32 overflow: " + value);
-    return new Operand<int32_t>(static_cast<int32_t>(v), Int32);
-
+    return new Operand<int32_t>(valueAs<int32_t>(parseInt32(value).valueOrRaise()), Int32);
 }
 
 IOperand const* OperandFactory::createFloat(std::string const& value) const
 {
-    long double v = parseFloatStrict(value);
-    if (v < -std::numeric_limits<float>::max())
-        throw UnderflowException("Float underflow: " + value);
-    if (v > std::numeric_limits<float>::max())
-        throw OverflowException("Float overflow: " + value);
-    return new Operand<float>(static_cast<float>(v), Float);
+    return new Operand<float>(valueAs<float>(parseFloat(value).valueOrRaise()), Float);
 }
 
 IOperand const* OperandFactory::createDouble(std::string const& value) const
 {
-    long double v = parseFloatStrict(value);
-    if (v < -std::numeric_limits<double>::max())
-        throw UnderflowException("Double underflow: " + value);
-    if (v > std::numeric_limits<double>::max())
-        throw OverflowException("Double overflow: " + value);
-    return new Operand<double>(static_cast<double>(v), Double);
+    return new Operand<double>(valueAs<double>(parseDouble(value).valueOrRaise()), Double);
 }
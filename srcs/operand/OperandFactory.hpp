@@ -1,10 +1,15 @@
 #pragma once
 #include <string>
 #include "IOperand.hpp"
+#include "OperandValue.hpp"
+#include "../exception/Error.hpp"
 
 class OperandFactory {
 public:
     static IOperand const* createOperand(eOperandType type, std::string const& value);
+    /* Same validation as createOperand, but yields the native value only. */
+    static Expected<OperandValue> tryCreateValue(eOperandType type, std::string const& value);
+    static OperandValue createValue(eOperandType type, std::string const& value);
 
 private:
     OperandFactory();
@@ -13,6 +18,13 @@ private:
     ~OperandFactory();
 
     typedef IOperand const* (OperandFactory::*CreateFn)(std::string const&) const;
+    typedef Expected<OperandValue> (*ParseFn)(std::string const&);
+
+    static Expected<OperandValue> parseInt8(std::string const& value);
+    static Expected<OperandValue> parseInt16(std::string const& value);
+    static Expected<OperandValue> parseInt32(std::string const& value);
+    static Expected<OperandValue> parseFloat(std::string const& value);
+    static Expected<OperandValue> parseDouble(std::string const& value);
 
     IOperand const* createInt8(std::string const& value) const;
     IOperand const* createInt16(std::string const& value) const;
@@ -0,0 +1,73 @@
+#pragma once
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include "IOperand.hpp"
+
+/* Native 8-byte value slot.
+ * Integer types are stored sign-extended in `i`, so every integer width
+ * shares one representation; Float and Double use their own member.
+ * The eOperandType tag lives next to the slot (see OperandStack).
+ */
+union OperandValue
+{
+    int64_t i;
+    float f;
+    double d;
+};
+static_assert(sizeof(OperandValue) == 8, "OperandValue must stay one 8-byte slot");
+
+template <typename T>
+inline T valueAs(OperandValue v)
+{
+    if constexpr (std::is_same<T, float>::value)
+        return v.f;
+    else if constexpr (std::is_same<T, double>::value)
+        return v.d;
+    else
+        return static_cast<T>(v.i);
+}
+
+template <typename T>
+inline OperandValue makeValue(T x)
+{
+    OperandValue v;
+    if constexpr (std::is_same<T, float>::value)
+        v.f = x;
+    else if constexpr (std::is_same<T, double>::value)
+        v.d = x;
+    else
+        v.i = static_cast<int64_t>(x);
+    return v;
+}
+
+/* Largest canonical representation: "-1.7976931348623157e+308". */
+constexpr size_t kMaxValueChars = 32;
+
+/* Canonical text of a value, identical to Operand<T>::toString():
+ * integers in decimal, Float with max_digits10 (9) and Double with
+ * max_digits10 (17) significant digits in %g style.
+ * Writes into `buf` (at least kMaxValueChars) and returns the length.
+ */
+inline size_t formatValue(char* buf, eOperandType type, OperandValue v)
+{
+    std::to_chars_result res;
+
+    switch (type)
+    {
+        case Float:
+            res = std::to_chars(buf, buf + kMaxValueChars, v.f, std::chars_format::general,
+                                std::numeric_limits<float>::max_digits10);
+            break;
+        case Double:
+            res = std::to_chars(buf, buf + kMaxValueChars, v.d, std::chars_format::general,
+                                std::numeric_limits<double>::max_digits10);
+            break;
+        default:
+            res = std::to_chars(buf, buf + kMaxValueChars, v.i);
+            break;
+    }
+    return static_cast<size_t>(res.ptr - buf);
+}
@@ -1,10 +1,12 @@
 #include <iostream>
 #include "InputReader.hpp"
 #include "../exception/Exception.hpp"
+#include "../stats/MemStats.hpp"
 
-inputReader::inputReader(const std::string& filename, bool isStdin)
+inputReader::inputReader(const std::string& filename, bool isStdin) : _memoryStream(nullptr)
 {
     this->_lastLineStored = 0;
+    this->_offset = 0;
     if (isStdin)
     {
         this->_file = &std::cin;
@@ -20,6 +22,13 @@ inputReader::inputReader(const std::string& filename, bool isStdin)
     }
 }
 
+inputReader::inputReader(const unsigned char* data, size_t size) : _memory(data, size), _memoryStream(&_memory)
+{
+    this->_lastLineStored = 0;
+    this->_offset = 0;
+    this->_file = &this->_memoryStream;
+}
+
 inputReader::~inputReader()
 {
     if (this->_fileStream.is_open())
@@ -28,11 +37,14 @@ inputReader::~inputReader()
 
 size_t inputReader::readProgram(size_t max_lines)
 {
+    MemScope scope(MemSubsystem::Input);
     std::string line;
     int initLineNumber = this->_lastLineStored;
 
     while (std::getline(*this->_file, line))
     {
+        uint64_t offset = this->_offset;
+        this->_offset += line.size() + 1;
         this->_lastLineStored++;
         if (this->_file == &std::cin)
         {
@@ -42,7 +54,7 @@ size_t inputReader::readProgram(size_t max_lines)
                 break;
             }
         }
-        this->_lines.push_back(Line{this->_lastLineStored, line});
+        this->_lines.push_back(Line{this->_lastLineStored, line, offset});
         if ((this->_lastLineStored - initLineNumber) == max_lines)
             break;
     }
@@ -59,3 +71,14 @@ Line inputReader::getLine()
     this->_lines.pop_front();
     return line;
 }
+
+void inputReader::seek(uint64_t offset, size_t lineNo)
+{
+    this->_file->clear();
+    this->_file->seekg(static_cast<std::streamoff>(offset));
+    if (!*this->_file)
+        throw InvalidValue("Cannot seek input to offset " + std::to_string(offset));
+    this->_lines.clear();
+    this->_offset = offset;
+    this->_lastLineStored = lineNo - 1;
+}
@@ -1,23 +1,40 @@
 #pragma once
+#include <cstdint>
 #include <deque>
 #include <string>
 #include <istream>
 #include <fstream>
+#include <streambuf>
 
 struct Line {
     size_t no;
     std::string text;
+    uint64_t offset = 0;    /* of its first byte in the input file */
+};
+
+/* Read-only streambuf over bytes held in memory, such as a MappedFile. */
+class MemoryBuffer : public std::streambuf {
+    public:
+        MemoryBuffer() {}
+        MemoryBuffer(const unsigned char* data, size_t size)
+        {
+            char* begin = const_cast<char*>(reinterpret_cast<const char*>(data));
+            setg(begin, begin, begin + size);
+        }
 };
 
 class inputReader {
     private:
         // size_t lastLineRead; // Last one was claimed from the inputReader to process
         size_t _lastLineStored; // Last one was actually readed.
+        uint64_t _offset;       // Input bytes consumed so far.
         
         std::deque<Line> _lines;
         
         std::istream* _file;
         std::ifstream _fileStream;
+        MemoryBuffer _memory;
+        std::istream _memoryStream;
         
 
 
@@ -28,11 +45,18 @@ class inputReader {
 
     public:
         inputReader(const std::string& filename, bool isStdin);
+        /* Reads the `size` bytes at `data`, which must outlive it; seek()
+         * is for files only. */
+        inputReader(const unsigned char* data, size_t size);
         ~inputReader();
 
         size_t readProgram(size_t max_lines);
 
         Line getLine();
+
+        /* Continues reading a file at byte `offset`, the start of line
+         * `lineNo`; lines already queued are dropped. */
+        void seek(uint64_t offset, size_t lineNo);
 };
 
 
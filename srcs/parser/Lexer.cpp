@@ -1,11 +1,29 @@
 #include "Lexer.hpp"
 
+static const ErrorDesc m_unterminatedString = { ErrorKind::Lexical, "unterminated string literal" };
+static const ErrorDesc m_digitAfterMinus = { ErrorKind::Lexical, "expected digit after '-'" };
+static const ErrorDesc m_digitAfterDot = { ErrorKind::Lexical, "expected digit after '.'" };
+static const ErrorDesc m_unexpectedChar = { ErrorKind::Lexical, "unexpected char '%s'" };
+
 std::vector<Token> Lexer::tokenize(Line const& ln)
+{
+    return tryTokenize(ln).valueOrRaise();
+}
+
+Expected<std::vector<Token>> Lexer::tryTokenize(Line const& ln)
 {
     std::string s = ln.text;
-    auto pos = s.find(';');
-    if (pos != std::string::npos)
-        s = s.substr(0, pos);
+    bool inString = false;
+    for (size_t pos = 0; pos < s.size(); ++pos)
+    {
+        if (s[pos] == '"')
+            inString = !inString;
+        else if (s[pos] == ';' && !inString)
+        {
+            s = s.substr(0, pos);
+            break;
+        }
+    }
 
 
     std::vector<Token> out;
@@ -47,6 +65,18 @@ std::vector<Token> Lexer::tokenize(Line const& ln)
             continue;
         }
 
+        if (s[i] == '"')
+        {
+            size_t start = i++;
+            while (i < s.size() && s[i] != '"')
+                ++i;
+            if (i >= s.size())
+                return Error(m_unterminatedString, ln.no, (int)start + 1);
+            out.push_back({TokenKind::String, s.substr(start + 1, i - start - 1), ln.no, (int)start + 1});
+            ++i;
+            continue;
+        }
+
         if (s[i] == '-' || std::isdigit((unsigned char)s[i]))
         {
             size_t start = i;
@@ -54,7 +84,7 @@ std::vector<Token> Lexer::tokenize(Line const& ln)
                 ++i;
             if (i >= s.size() || !std::isdigit((unsigned char)s[i]))
             {
-                throw LexicalError(ln.no, (int)start + 1, "expected digit after '-'");
+                return Error(m_digitAfterMinus, ln.no, (int)start + 1);
             }
             while (i < s.size() && std::isdigit((unsigned char)s[i]))
                 ++i;
@@ -62,7 +92,7 @@ std::vector<Token> Lexer::tokenize(Line const& ln)
             {
                 ++i;
                 if (i >= s.size() || !std::isdigit((unsigned char)s[i]))
-                    throw LexicalError(ln.no, (int)i + 1, "expected digit after '.'");
+                    return Error(m_digitAfterDot, ln.no, (int)i + 1);
                 
                 while (i < s.size() && std::isdigit((unsigned char)s[i]))
                     ++i;
@@ -71,7 +101,7 @@ std::vector<Token> Lexer::tokenize(Line const& ln)
             continue;
         }
 
-        throw LexicalError(ln.no, (int)i + 1, std::string("unexpected char '") + s[i] + "'");
+        return Error(m_unexpectedChar, ln.no, (int)i + 1, std::string_view(&s[i], 1));
     }
 
     out.push_back({TokenKind::End, "", ln.no, (int)s.size() + 1});
@@ -3,15 +3,17 @@
 #include <string>
 #include "InputReader.hpp"
 #include "../exception/Exception.hpp"
+#include "../exception/Error.hpp"
 
 /* Token kinds
  * Ident  - identifiers (e.g., 'push', 'pop', 'int32', etc.)
  * Number - numeric literals (e.g., '123', '-456', etc.)
  * LParen - left parenthesis '('
  * RParen - right parenthesis ')'
+ * String - double-quoted literal, lexeme without the quotes (e.g., a path)
  * End    - end of line/input
  */
-enum class TokenKind { Ident, Number, LParen, RParen, End };
+enum class TokenKind { Ident, Number, LParen, RParen, String, End };
 
 struct Token {
     TokenKind kind;
@@ -27,5 +29,7 @@ class Lexer {
         const Lexer& operator=(const Lexer& other);
         ~Lexer();
     public:
+        static Expected<std::vector<Token>> tryTokenize(Line const& ln);
+        /* Throws LexicalError. */
         static std::vector<Token> tokenize(Line const& ln);
 };
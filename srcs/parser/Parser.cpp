@@ -5,6 +5,23 @@
 #include <iostream>
 // #define PRINT_TOKENS
 
+static const ErrorDesc m_duplicateOpcode = { ErrorKind::Syntax, "Duplicate instruction/opcode: %s" };
+static const ErrorDesc m_duplicateType = { ErrorKind::Syntax, "Duplicate type specifier: %s" };
+static const ErrorDesc m_unknownIdent = { ErrorKind::Syntax, "Unknown identifier: %s" };
+static const ErrorDesc m_numberOutsideParens = { ErrorKind::Syntax, "Unexpected number token outside parentheses: %s" };
+static const ErrorDesc m_missingTypeForValue = { ErrorKind::Syntax, "Missing type specifier for value: %s" };
+static const ErrorDesc m_loadExpectsPath = { ErrorKind::Syntax, "load expects a quoted path, not a value: %s" };
+static const ErrorDesc m_invalidFloat = { ErrorKind::Syntax, "Invalid float/double literal: %s" };
+static const ErrorDesc m_unexpectedString = { ErrorKind::Syntax, "Unexpected string literal: \"%s\"" };
+static const ErrorDesc m_missingTypeForLoad = { ErrorKind::Syntax, "Missing type specifier for load" };
+static const ErrorDesc m_duplicatePath = { ErrorKind::Syntax, "Duplicate path for load" };
+static const ErrorDesc m_endInsideParens = { ErrorKind::Syntax, "Unexpected end of line inside parentheses" };
+static const ErrorDesc m_missingValue = { ErrorKind::Syntax, "Missing value for instruction" };
+static const ErrorDesc m_reductionCountType = { ErrorKind::Syntax, "Reduction count must be int32" };
+static const ErrorDesc m_repeatCountType = { ErrorKind::Syntax, "Repeat count must be int32" };
+static const ErrorDesc m_missingName = { ErrorKind::Syntax, "Missing label name" };
+static const ErrorDesc m_unexpectedName = { ErrorKind::Syntax, "Expected a label name, not a value: %s" };
+
 static bool m_isValidFloatLiteral(const std::string& s)
 {
     bool hasDigitsAfter;
@@ -35,17 +52,47 @@ static bool m_isValidFloatLiteral(const std::string& s)
     return hasDigitsAfter && (i == s.size());
 }
 
-Instruction Parser::parseInstruction(const std::vector<Token>& tokens)
+static bool m_isReduction(OpCode op)
+{
+    return op == OpCode::Sum || op == OpCode::Prod || op == OpCode::Min || op == OpCode::Max;
+}
+
+/* label, jmp, jz and jnz take a bare name: `jmp loop`. */
+static bool m_takesName(OpCode op)
+{
+    return op == OpCode::Label || op == OpCode::Jmp || op == OpCode::Jz || op == OpCode::Jnz;
+}
+
+static bool m_takesValue(OpCode op)
+{
+    return op == OpCode::Push || op == OpCode::Assert || op == OpCode::Load || op == OpCode::Repeat
+        || m_isReduction(op);
+}
+
+Instruction Parser::parseInstruction(const std::vector<Token>& tokens, ConstantPool& pool)
+{
+    return tryParseInstruction(tokens, pool).valueOrRaise();
+}
+
+Expected<Instruction> Parser::tryParseInstruction(const std::vector<Token>& tokens, ConstantPool& pool)
 {
     Instruction instr;
     bool insideParens = false;
     eOperandType argType = None;
+    const Token* value = nullptr;
+    eOperandType valueType = None;
+    const Token* name = nullptr;
     
     static const std::unordered_map<std::string_view, OpCode> opMap = {
         {"push", OpCode::Push}, {"pop", OpCode::Pop}, {"dump", OpCode::Dump},
         {"assert", OpCode::Assert}, {"add", OpCode::Add}, {"sub", OpCode::Sub},
         {"mul", OpCode::Mul}, {"div", OpCode::Div}, {"mod", OpCode::Mod},
-        {"print", OpCode::Print}, {"exit", OpCode::Exit}
+        {"print", OpCode::Print}, {"exit", OpCode::Exit},
+        {"sum", OpCode::Sum}, {"prod", OpCode::Prod}, {"min", OpCode::Min}, {"max", OpCode::Max},
+        {"dup", OpCode::Dup}, {"swap", OpCode::Swap}, {"over", OpCode::Over}, {"rot", OpCode::Rot},
+        {"load", OpCode::Load},
+        {"label", OpCode::Label}, {"jmp", OpCode::Jmp}, {"jz", OpCode::Jz}, {"jnz", OpCode::Jnz},
+        {"repeat", OpCode::Repeat}, {"end", OpCode::End}
     };
 
     static const std::unordered_map<std::string_view, eOperandType> typeMap = {
@@ -55,6 +102,7 @@ Instruction Parser::parseInstruction(const std::vector<Token>& tokens)
 
     instr.op = OpCode::None;
     instr.line = tokens.empty() ? 0 : tokens[0].line;
+    instr.constant = ConstantPool::kNone;
 
     for (const auto& token : tokens)
     {
@@ -66,6 +114,7 @@ Instruction Parser::parseInstruction(const std::vector<Token>& tokens)
             case TokenKind::Number: std::cout << "Number"; break;
             case TokenKind::LParen: std::cout << "LParen"; break;
             case TokenKind::RParen: std::cout << "RParen"; break;
+            case TokenKind::String: std::cout << "String"; break;
             case TokenKind::End: std::cout << "End"; break;
         }
         std::cout << ", Lexeme: '" << token.lexeme << "', Line: " << token.line << ", Col: " << token.col << std::endl;
@@ -76,11 +125,17 @@ Instruction Parser::parseInstruction(const std::vector<Token>& tokens)
         case TokenKind::Ident:
         {
             std::string_view lex = token.lexeme;
+            if (m_takesName(instr.op) && !name && !insideParens)
+            {
+                /* Any word can name a label, even `push` or `int8`. */
+                name = &token;
+                break;
+            }
             auto opIt = opMap.find(lex);
             if (opIt != opMap.end())
             {
                 if (instr.op != OpCode::None)
-                    throw SyntaxError(token.line, token.col, "Duplicate instruction/opcode: " + token.lexeme);
+                    return Error(m_duplicateOpcode, token.line, token.col, token.lexeme);
                 instr.op = opIt->second;
             }
             else
@@ -89,12 +144,12 @@ Instruction Parser::parseInstruction(const std::vector<Token>& tokens)
                 if (typeIt != typeMap.end())
                 {
                     if (argType != None)
-                        throw SyntaxError(token.line, token.col, "Duplicate type specifier: " + token.lexeme);
+                        return Error(m_duplicateType, token.line, token.col, token.lexeme);
                     argType = typeIt->second;
                 }
                 else
                 {
-                    throw SyntaxError(token.line, token.col, "Unknown identifier: " + token.lexeme);
+                    return Error(m_unknownIdent, token.line, token.col, token.lexeme);
                 }
             }
             break;
@@ -103,19 +158,37 @@ Instruction Parser::parseInstruction(const std::vector<Token>& tokens)
         {
             if (!insideParens)
             {
-                throw SyntaxError(token.line, token.col, "Unexpected number token outside parentheses: " + token.lexeme);
+                return Error(m_numberOutsideParens, token.line, token.col, token.lexeme);
             }
 
             if (argType == None)
-                throw SyntaxError(token.line, token.col, "Missing type specifier for value: " + token.lexeme);
+                return Error(m_missingTypeForValue, token.line, token.col, token.lexeme);
+            if (m_takesName(instr.op))
+                return Error(m_unexpectedName, token.line, token.col, token.lexeme);
+            if (instr.op == OpCode::Load)
+                return Error(m_loadExpectsPath, token.line, token.col, token.lexeme);
 
             if (argType == Float || argType == Double)
             {
                 if (!m_isValidFloatLiteral(token.lexeme))
-                    throw SyntaxError(token.line, token.col, "Invalid float/double literal: " + token.lexeme);
+                    return Error(m_invalidFloat, token.line, token.col, token.lexeme);
             }
 
-            instr.arg = OpValue{argType, token.lexeme};
+            value = &token;
+            valueType = argType;
+            break;
+        }
+        case TokenKind::String:
+        {
+            if (instr.op != OpCode::Load)
+                return Error(m_unexpectedString, token.line, token.col, token.lexeme);
+            if (argType == None)
+                return Error(m_missingTypeForLoad, token.line, token.col);
+            if (value)
+                return Error(m_duplicatePath, token.line, token.col);
+
+            value = &token;
+            valueType = argType;
             break;
         }
         case TokenKind::LParen:
@@ -126,8 +199,23 @@ Instruction Parser::parseInstruction(const std::vector<Token>& tokens)
             break;
         case TokenKind::End:
             if (insideParens)
-                throw SyntaxError(token.line, token.col, "Unexpected end of line inside parentheses");
-
+                return Error(m_endInsideParens, token.line, token.col);
+            if (m_takesValue(instr.op) && !value)
+                return Error(m_missingValue, token.line, token.col);
+            if (m_isReduction(instr.op) && valueType != Int32)
+                return Error(m_reductionCountType, token.line, token.col);
+            if (instr.op == OpCode::Repeat && valueType != Int32)
+                return Error(m_repeatCountType, token.line, token.col);
+            if (m_takesName(instr.op) && !name)
+                return Error(m_missingName, token.line, token.col);
+
+            /* Range errors stay in the pool until the instruction runs. */
+            if (m_takesName(instr.op))
+                instr.constant = pool.internText(None, name->lexeme);
+            else if (instr.op == OpCode::Load)
+                instr.constant = pool.internText(valueType, value->lexeme);
+            else if (m_takesValue(instr.op))
+                instr.constant = pool.intern(valueType, value->lexeme);
             return instr;
         }
 
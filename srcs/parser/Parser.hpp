@@ -15,6 +15,10 @@ class Parser
         ~Parser();
 
     public:
-        static Instruction parseInstruction(const std::vector<Token>& tokens);
+        /* Literals are interned into `pool`, which the instruction then
+         * refers to; keep it alive (and uncleared) until it has run. */
+        static Expected<Instruction> tryParseInstruction(const std::vector<Token>& tokens, ConstantPool& pool);
+        /* Throws SyntaxError. */
+        static Instruction parseInstruction(const std::vector<Token>& tokens, ConstantPool& pool);
 
 };
\ No newline at end of file
@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <system_error>
+#include <vector>
+#include "Profiler.hpp"
+
+Profiler::Slot Profiler::s_table[Profiler::kTableSize];
+std::atomic<uint64_t> Profiler::s_dropped{0};
+
+/* Only lock-free atomics on static storage: safe inside a signal handler. */
+void Profiler::m_onSignal(int sig)
+{
+    (void)sig;
+    uint32_t line = static_cast<uint32_t>(s_currentLine.load(std::memory_order_relaxed));
+    size_t h = (line * 2654435761u) & (kTableSize - 1);
+
+    for (size_t probe = 0; probe < kTableSize; ++probe)
+    {
+        Slot& slot = s_table[(h + probe) & (kTableSize - 1)];
+        uint32_t cur = slot.line.load(std::memory_order_relaxed);
+
+        /* Slots store line + 1 so that 0 marks an empty slot. */
+        if (cur == 0)
+        {
+            uint32_t expected = 0;
+            if (!slot.line.compare_exchange_strong(expected, line + 1, std::memory_order_relaxed))
+                cur = expected;
+            else
+                cur = line + 1;
+        }
+        if (cur == line + 1)
+        {
+            slot.count.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+    s_dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+Profiler::Profiler(const std::string& outPath, const std::string& root, long intervalUs)
+    : _outPath(outPath), _root(root), _timer(), _oldAction(), _armed(false)
+{
+    struct sigaction sa;
+    struct sigevent sev;
+    struct itimerspec its;
+
+    for (Slot& slot : s_table)
+    {
+        slot.line.store(0, std::memory_order_relaxed);
+        slot.count.store(0, std::memory_order_relaxed);
+    }
+    s_dropped.store(0, std::memory_order_relaxed);
+    s_currentLine.store(0, std::memory_order_relaxed);
+
+    std::memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = &Profiler::m_onSignal;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGPROF, &sa, &_oldAction) != 0)
+        throw std::system_error(errno, std::generic_category(), "sigaction(SIGPROF)");
+
+    std::memset(&sev, 0, sizeof(sev));
+    sev.sigev_notify = SIGEV_SIGNAL;
+    sev.sigev_signo = SIGPROF;
+    if (timer_create(CLOCK_PROCESS_CPUTIME_ID, &sev, &_timer) != 0)
+    {
+        int err = errno;
+        sigaction(SIGPROF, &_oldAction, nullptr);
+        throw std::system_error(err, std::generic_category(), "timer_create");
+    }
+
+    its.it_interval.tv_sec = intervalUs / 1000000;
+    its.it_interval.tv_nsec = (intervalUs % 1000000) * 1000;
+    its.it_value = its.it_interval;
+    if (timer_settime(_timer, 0, &its, nullptr) != 0)
+    {
+        int err = errno;
+        timer_delete(_timer);
+        sigaction(SIGPROF, &_oldAction, nullptr);
+        throw std::system_error(err, std::generic_category(), "timer_settime");
+    }
+    _armed = true;
+}
+
+Profiler::~Profiler()
+{
+    struct sigaction ignore;
+
+    if (!_armed)
+        return;
+
+    /* The old action is usually SIG_DFL, which terminates the process:
+     * a SIGPROF still pending on some thread is discarded under SIG_IGN
+     * before it is put back. */
+    std::memset(&ignore, 0, sizeof(ignore));
+    ignore.sa_handler = SIG_IGN;
+    sigemptyset(&ignore.sa_mask);
+    sigaction(SIGPROF, &ignore, nullptr);
+    timer_delete(_timer);
+    sigaction(SIGPROF, &_oldAction, nullptr);
+    m_report();
+}
+
+void Profiler::m_report() const
+{
+    std::vector<std::pair<uint32_t, uint64_t>> samples;
+    uint32_t maxLine = 0;
+    uint64_t total = 0;
+
+    for (const Slot& slot : s_table)
+    {
+        uint32_t line = slot.line.load(std::memory_order_relaxed);
+        uint64_t count = slot.count.load(std::memory_order_relaxed);
+        if (line == 0 || count == 0)
+            continue;
+        samples.emplace_back(line - 1, count);
+        maxLine = std::max(maxLine, line - 1);
+        total += count;
+    }
+    std::sort(samples.begin(), samples.end());
+
+    /* Range width: smallest power of ten giving at most ~32 ranges. */
+    uint32_t width = 1;
+    while (maxLine / width > 32)
+        width *= 10;
+
+    std::map<uint32_t, uint64_t> ranges;
+    std::ofstream out(_outPath);
+    if (!out.is_open())
+    {
+        std::cerr << "Failed to open profile output: " << _outPath << "\n";
+        return;
+    }
+
+    for (const auto& [line, count] : samples)
+    {
+        if (line == 0)
+        {
+            out << _root << ";(front-end) " << count << "\n";
+            continue;
+        }
+        uint32_t first = ((line - 1) / width) * width + 1;
+        ranges[first] += count;
+        out << _root << ";lines " << first << "-" << first + width - 1
+            << ";line " << line << " " << count << "\n";
+    }
+
+    std::vector<std::pair<uint64_t, uint32_t>> hot;
+    for (const auto& [first, count] : ranges)
+        hot.emplace_back(count, first);
+    std::sort(hot.rbegin(), hot.rend());
+
+    std::cerr << "Profile: " << total << " samples written to " << _outPath;
+    if (s_dropped.load(std::memory_order_relaxed))
+        std::cerr << " (" << s_dropped.load(std::memory_order_relaxed) << " dropped)";
+    std::cerr << "\n";
+    for (size_t i = 0; i < hot.size() && i < 5; ++i)
+    {
+        std::cerr << "  lines " << hot[i].second << "-" << hot[i].second + width - 1 << ": "
+                  << hot[i].first << " samples ("
+                  << (100 * hot[i].first / (total ? total : 1)) << "%)\n";
+    }
+}
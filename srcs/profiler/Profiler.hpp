@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <signal.h>
+#include <time.h>
+
+/* Sampling profiler.
+ * A SIGPROF timer (timer_create on the process CPU clock) samples the source
+ * line currently being executed. The signal handler only touches atomics and
+ * a preallocated open-addressing table, so it is async-signal-safe.
+ * On destruction the samples are aggregated into line ranges and written as
+ * collapsed stacks ("root;lines A-B;line N count") for flamegraph tools.
+ *
+ * There is one current line for the whole process, so only one program
+ * may run at a time: --profile is rejected with --rows, --sessions and
+ * --parallel-segments.
+ */
+class Profiler
+{
+    private:
+        static constexpr size_t kTableSize = 1 << 16; /* distinct lines tracked */
+        static constexpr long kDefaultIntervalUs = 1000;
+
+        struct Slot
+        {
+            std::atomic<uint32_t> line;
+            std::atomic<uint64_t> count;
+        };
+
+        static Slot s_table[kTableSize];
+        static std::atomic<uint64_t> s_dropped;
+        inline static std::atomic<int> s_currentLine{0};
+
+        std::string _outPath;
+        std::string _root;
+        timer_t _timer;
+        struct sigaction _oldAction;
+        bool _armed;
+
+        static void m_onSignal(int sig);
+        void m_report() const;
+
+        Profiler();
+        Profiler(const Profiler& other);
+        const Profiler& operator=(const Profiler& other);
+
+    public:
+        Profiler(const std::string& outPath, const std::string& root, long intervalUs = kDefaultIntervalUs);
+        ~Profiler();
+
+        static void setLine(int line)
+        {
+            s_currentLine.store(line, std::memory_order_relaxed);
+        }
+};
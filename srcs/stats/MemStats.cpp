@@ -0,0 +1,113 @@
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+#include "MemStats.hpp"
+
+namespace
+{
+    const char* m_subsystemName(MemSubsystem sub)
+    {
+        switch (sub)
+        {
+            case MemSubsystem::Other: return "other";
+            case MemSubsystem::Input: return "input";
+            case MemSubsystem::Lexer: return "lexer";
+            case MemSubsystem::Parser: return "parser";
+            case MemSubsystem::Stack: return "stack";
+            case MemSubsystem::Output: return "output";
+            case MemSubsystem::Count: break;
+        }
+        return "unknown";
+    }
+}
+
+#ifndef AVM_NO_MEMSTATS
+/* Replaceable global allocation functions.
+ * Every block carries a small header with its size and the subsystem that
+ * allocated it, so frees are charged back to the right counters even when
+ * ownership crosses subsystems (e.g. a Line moving from input to lexer).
+ * Aligned (std::align_val_t) overloads keep their default implementation.
+ * Left out with -DAVM_NO_MEMSTATS (see MemStats.hpp).
+ */
+namespace
+{
+    struct alignas(alignof(std::max_align_t)) BlockHeader
+    {
+        size_t size;
+        MemSubsystem sub;
+    };
+
+    void* m_alloc(size_t size)
+    {
+        BlockHeader* h = static_cast<BlockHeader*>(std::malloc(sizeof(BlockHeader) + size));
+        if (!h)
+            return nullptr;
+        h->size = size;
+        h->sub = MemStats::current();
+        if (MemStats::enabled())
+            MemStats::onAlloc(h->sub, size);
+        return h + 1;
+    }
+
+    void m_free(void* p)
+    {
+        if (!p)
+            return;
+        BlockHeader* h = static_cast<BlockHeader*>(p) - 1;
+        if (MemStats::enabled())
+            MemStats::onFree(h->sub, h->size);
+        std::free(h);
+    }
+
+    void* m_allocOrThrow(size_t size)
+    {
+        void* p;
+        while ((p = m_alloc(size)) == nullptr)
+        {
+            std::new_handler handler = std::get_new_handler();
+            if (!handler)
+                throw std::bad_alloc();
+            handler();
+        }
+        return p;
+    }
+}
+
+void* operator new(size_t size) { return m_allocOrThrow(size); }
+void* operator new[](size_t size) { return m_allocOrThrow(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return m_alloc(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return m_alloc(size); }
+void operator delete(void* p) noexcept { m_free(p); }
+void operator delete[](void* p) noexcept { m_free(p); }
+void operator delete(void* p, size_t) noexcept { m_free(p); }
+void operator delete[](void* p, size_t) noexcept { m_free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { m_free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { m_free(p); }
+#endif
+
+void MemStats::report(std::ostream& os)
+{
+    os << "Memory stats:\n"
+       << "  " << std::left << std::setw(8) << "subsys"
+       << std::right << std::setw(12) << "allocs"
+       << std::setw(12) << "frees"
+       << std::setw(16) << "bytes"
+       << std::setw(14) << "peak-live" << "\n";
+
+    for (size_t i = 0; i < static_cast<size_t>(MemSubsystem::Count); ++i)
+    {
+        const MemCounters& c = s_counters[i];
+        os << "  " << std::left << std::setw(8) << m_subsystemName(static_cast<MemSubsystem>(i))
+           << std::right << std::setw(12) << c.allocs.load(std::memory_order_relaxed)
+           << std::setw(12) << c.frees.load(std::memory_order_relaxed)
+           << std::setw(16) << c.bytes.load(std::memory_order_relaxed)
+           << std::setw(14) << c.peakBytes.load(std::memory_order_relaxed) << "\n";
+    }
+#ifdef AVM_NO_MEMSTATS
+    os << "  (only stack chunks counted: built with AVM_NO_MEMSTATS)\n";
+#endif
+    os << "  peak stack depth:    " << s_peakStackDepth.load(std::memory_order_relaxed) << "\n"
+       << "  peak live operands:  " << s_peakOperands.load(std::memory_order_relaxed) << "\n"
+       << "  line memo hits:      " << s_memoHits.load(std::memory_order_relaxed) << "\n"
+       << "  line memo misses:    " << s_memoMisses.load(std::memory_order_relaxed) << "\n";
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+/* Subsystems allocations are charged to.
+ * The current subsystem is thread-local and set with MemScope; the replaced
+ * global operator new/delete (MemStats.cpp) tag every block with it.
+ *
+ * The replacement is linked into every binary and is paid for even
+ * without --mem-stats: each block gets a 16-byte header and each new
+ * reads the thread-local subsystem; only the counting is skipped. Build
+ * with -DAVM_NO_MEMSTATS to keep the default allocator; --mem-stats then
+ * reports only the explicitly tracked figures (stack chunks, depths,
+ * operands, memo).
+ */
+enum class MemSubsystem : uint8_t { Other = 0, Input, Lexer, Parser, Stack, Output, Count };
+
+struct MemCounters
+{
+    std::atomic<uint64_t> allocs{0};
+    std::atomic<uint64_t> frees{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<int64_t> liveBytes{0};
+    std::atomic<int64_t> peakBytes{0};
+};
+
+class MemStats
+{
+    private:
+        inline static std::atomic<bool> s_enabled{false};
+        inline static thread_local MemSubsystem s_current = MemSubsystem::Other;
+        inline static MemCounters s_counters[static_cast<size_t>(MemSubsystem::Count)];
+        inline static std::atomic<uint64_t> s_peakStackDepth{0};
+        inline static std::atomic<int64_t> s_liveOperands{0};
+        inline static std::atomic<int64_t> s_peakOperands{0};
+        inline static std::atomic<uint64_t> s_memoHits{0};
+        inline static std::atomic<uint64_t> s_memoMisses{0};
+
+        template <typename T>
+        static void m_raise(std::atomic<T>& peak, typename std::atomic<T>::value_type value)
+        {
+            T cur = peak.load(std::memory_order_relaxed);
+            while (value > cur && !peak.compare_exchange_weak(cur, value, std::memory_order_relaxed))
+                ;
+        }
+
+        MemStats();
+        MemStats(const MemStats& other);
+        const MemStats& operator=(const MemStats& other);
+        ~MemStats();
+
+    public:
+        static void enable() { s_enabled.store(true, std::memory_order_relaxed); }
+        static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+        static MemSubsystem current() { return s_current; }
+        static void setCurrent(MemSubsystem sub) { s_current = sub; }
+
+        static void onAlloc(MemSubsystem sub, size_t size)
+        {
+            MemCounters& c = s_counters[static_cast<size_t>(sub)];
+            c.allocs.fetch_add(1, std::memory_order_relaxed);
+            c.bytes.fetch_add(size, std::memory_order_relaxed);
+            m_raise(c.peakBytes, c.liveBytes.fetch_add(size, std::memory_order_relaxed) + size);
+        }
+
+        static void onFree(MemSubsystem sub, size_t size)
+        {
+            MemCounters& c = s_counters[static_cast<size_t>(sub)];
+            c.frees.fetch_add(1, std::memory_order_relaxed);
+            c.liveBytes.fetch_sub(size, std::memory_order_relaxed);
+        }
+
+        static void noteStackDepth(size_t depth)
+        {
+            m_raise(s_peakStackDepth, depth);
+        }
+
+        static void operandCreated()
+        {
+            m_raise(s_peakOperands, s_liveOperands.fetch_add(1, std::memory_order_relaxed) + 1);
+        }
+
+        static void operandDestroyed()
+        {
+            s_liveOperands.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        /* Parsed-line memo lookups of one Assembler, added when it goes. */
+        static void noteLineMemo(uint64_t hits, uint64_t misses)
+        {
+            s_memoHits.fetch_add(hits, std::memory_order_relaxed);
+            s_memoMisses.fetch_add(misses, std::memory_order_relaxed);
+        }
+
+        static void report(std::ostream& os);
+
+        static const MemCounters& counters(MemSubsystem sub) { return s_counters[static_cast<size_t>(sub)]; }
+        static uint64_t peakStackDepth() { return s_peakStackDepth.load(std::memory_order_relaxed); }
+};
+
+/* Charges allocations made while alive to a subsystem, restoring the
+ * previous one on scope exit. */
+class MemScope
+{
+    private:
+        MemSubsystem _previous;
+
+        MemScope(const MemScope& other);
+        const MemScope& operator=(const MemScope& other);
+
+    public:
+        explicit MemScope(MemSubsystem sub) : _previous(MemStats::current()) { MemStats::setCurrent(sub); }
+        ~MemScope() { MemStats::setCurrent(_previous); }
+};
@@ -0,0 +1,313 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../operand/Operand.hpp"
+#include "../operand/OperandFactory.hpp"
+#include "../operand/Arithmetic.hpp"
+#include "../vm/OperandStack.hpp"
+#include "../vm/vm.hpp"
+
+#if defined(BENCH_VM_MAIN)
+/* Micro benchmarks for the VM data paths.
+ * Usage: bench_abstract_vm [elements]   (default 10,000,000)
+ * Output goes to /dev/null; only timings are printed.
+ */
+
+static eOperandType m_typeFor(size_t i)
+{
+    static const eOperandType types[] = { Int8, Int32, Float, Int16, Double };
+    return types[i % 5];
+}
+
+static std::string m_literalFor(size_t i)
+{
+    switch (m_typeFor(i))
+    {
+        case Int8: return std::to_string(static_cast<int>(i % 100));
+        case Int16: return std::to_string(static_cast<int>(i % 30000));
+        case Int32: return std::to_string(static_cast<long long>(i));
+        case Float: return std::to_string(i % 1000) + ".25";
+        default: return std::to_string(i) + ".125";
+    }
+}
+
+template <typename Fn>
+static double m_time(Fn&& fn)
+{
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    std::chrono::duration<double, std::milli> ms = std::chrono::steady_clock::now() - start;
+    return ms.count();
+}
+
+static void benchDump(size_t count)
+{
+    std::ofstream devnull("/dev/null");
+    std::vector<IOperand const*> legacy;
+    OperandStack soa;
+
+    std::cout << "\n== dump of " << count << " elements ==\n";
+    double build = m_time([&]{
+        legacy.reserve(count);
+        for (size_t i = 0; i < count; ++i)
+            legacy.push_back(OperandFactory::createOperand(m_typeFor(i), m_literalFor(i)));
+    });
+    double dumpLegacy = m_time([&]{
+        for (auto it = legacy.rbegin(); it != legacy.rend(); ++it)
+            devnull << (*it)->toString() << '\n';
+        devnull.flush();
+    });
+    size_t int8Legacy = 0;
+    double scanLegacy = m_time([&]{
+        for (IOperand const* op : legacy)
+            int8Legacy += (op->getType() == Int8);
+    });
+    for (IOperand const* op : legacy)
+        delete op;
+    legacy.clear();
+    legacy.shrink_to_fit();
+
+    double buildSoa = m_time([&]{
+        for (size_t i = 0; i < count; ++i)
+            soa.push(m_typeFor(i), OperandFactory::createValue(m_typeFor(i), m_literalFor(i)));
+    });
+    double dumpSoa = m_time([&]{
+        soa.dump(devnull);
+        devnull.flush();
+    });
+    size_t int8Soa = 0;
+    double scanSoa = m_time([&]{
+        soa.forRange(0, soa.size(), [&](const uint8_t* tags, const OperandValue*, size_t n) {
+            for (size_t i = 0; i < n; ++i)
+                int8Soa += (tags[i] == Int8);
+        });
+    });
+
+    /* Heap operands precompute their text at construction, so the fair
+     * comparison for a dump-heavy program is build + dump. */
+    std::cout << "  heap IOperand* vector: build " << build << " ms, dump " << dumpLegacy
+              << " ms, total " << build + dumpLegacy << " ms, type scan " << scanLegacy << " ms\n"
+              << "  SoA OperandStack:      build " << buildSoa << " ms, dump " << dumpSoa
+              << " ms, total " << buildSoa + dumpSoa << " ms, type scan " << scanSoa << " ms\n";
+    if (int8Legacy != int8Soa)
+        std::cout << "  type scan mismatch!\n";
+}
+
+static void benchReduce(size_t count)
+{
+    ConstantPool pool;
+    Instruction push{1, OpCode::Push, pool.intern(Int32, "7")};
+    Instruction add{2, OpCode::Add, ConstantPool::kNone};
+    Instruction pop{3, OpCode::Pop, ConstantPool::kNone};
+    Instruction sum{2, OpCode::Sum, pool.intern(Int32, std::to_string(count))};
+    vm chained;
+    vm reduced;
+
+    std::cout << "\n== reduce " << count << " int32 values ==\n";
+    for (size_t i = 0; i < count; ++i)
+    {
+        chained.executeInstruction(push, pool);
+        reduced.executeInstruction(push, pool);
+    }
+    double addMs = m_time([&]{
+        for (size_t i = 1; i < count; ++i)
+            chained.executeInstruction(add, pool);
+    });
+    double sumMs = m_time([&]{
+        reduced.executeInstruction(sum, pool);
+    });
+    chained.executeInstruction(pop, pool);
+    reduced.executeInstruction(pop, pool);
+    std::cout << "  " << count - 1 << " x add: " << addMs << " ms\n"
+              << "  sum int32(" << count << "): " << sumMs << " ms\n";
+}
+
+/* One binary operation per (lhs type, rhs type, op) drawn from a fixed
+ * mix, through the heap Operand operators and the native arith path. */
+static void benchDispatch(size_t count)
+{
+    const eOperandType types[] = { Int8, Int16, Int32, Float, Double };
+    const char* literals[] = { "3", "-7", "12345", "1.5", "-2.25" };
+    const char ops[] = { '+', '-', '*', '/', '%' };
+    std::vector<const IOperand*> heap;
+    std::vector<OperandValue> native;
+    std::vector<uint32_t> picks(count);
+    uint32_t seed = 12345;
+
+    for (eOperandType t : types)
+    {
+        heap.push_back(OperandFactory::createOperand(t, literals[t]));
+        native.push_back(OperandFactory::createValue(t, literals[t]));
+    }
+    for (uint32_t& p : picks)
+    {
+        seed = seed * 1103515245u + 12345u;
+        p = (seed >> 8) % 125;
+    }
+
+    std::cout << "\n== binary dispatch, " << count << " mixed operations ==\n";
+    size_t heapSink = 0;
+    double heapMs = m_time([&]{
+        for (uint32_t p : picks)
+        {
+            const IOperand& a = *heap[p / 25];
+            const IOperand& b = *heap[p / 5 % 5];
+            const IOperand* r = nullptr;
+            switch (ops[p % 5])
+            {
+                case '+': r = a + b; break;
+                case '-': r = a - b; break;
+                case '*': r = a * b; break;
+                case '/': r = a / b; break;
+                default: r = a % b; break;
+            }
+            heapSink += r->getType();
+            delete r;
+        }
+    });
+    int64_t switchSink = 0;
+    double switchMs = m_time([&]{
+        for (uint32_t p : picks)
+        {
+            eOperandType rt;
+            switchSink += arith::apply(ops[p % 5], types[p / 25], native[p / 25],
+                                       types[p / 5 % 5], native[p / 5 % 5], rt).i;
+        }
+    });
+    int64_t tableSink = 0;
+    double tableMs = m_time([&]{
+        for (uint32_t p : picks)
+        {
+            arith::Op op = static_cast<arith::Op>(p % 5);
+            tableSink += arith::kernelFor(types[p / 25], types[p / 5 % 5], op)(native[p / 25], native[p / 5 % 5]).i;
+        }
+    });
+    std::cout << "  Operand operators:      " << heapMs << " ms\n"
+              << "  arith::apply (switch):  " << switchMs << " ms\n"
+              << "  arith::kernelFor table: " << tableMs << " ms\n";
+    if (heapSink == 0 && switchSink == 0 && tableSink == 0)
+        std::cout << "  (no work)\n";
+    for (const IOperand* o : heap)
+        delete o;
+}
+
+/* Float literal conversion: OperandFactory against plain strtold, the
+ * conversion it used for every literal before the decimal fast path. */
+static void benchFloatLiterals(size_t count)
+{
+    std::vector<std::string> literals;
+    uint32_t seed = 777;
+
+    literals.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        seed = seed * 1103515245u + 12345u;
+        literals.push_back(std::to_string(static_cast<int>(seed % 2000000) - 1000000) + "." + std::to_string(seed % 100000));
+    }
+
+    std::cout << "\n== float literals, " << count << " conversions ==\n";
+    double factorySink = 0;
+    double factoryMs = m_time([&]{
+        for (const std::string& s : literals)
+            factorySink += OperandFactory::createValue(Double, s).d;
+    });
+    long double strtoldSink = 0;
+    double strtoldMs = m_time([&]{
+        for (const std::string& s : literals)
+            strtoldSink += std::strtold(s.c_str(), nullptr);
+    });
+    std::cout << "  OperandFactory::createValue: " << factoryMs << " ms\n"
+              << "  strtold:                     " << strtoldMs << " ms\n";
+    if (factorySink == 0 && strtoldSink == 0)
+        std::cout << "  (no work)\n";
+}
+
+/* In-range int32 adds with and without --checked: the overflow builtins
+ * should keep the checked loop close to the wrapping one. */
+static void benchChecked(size_t count)
+{
+    ConstantPool pool;
+    Instruction push{1, OpCode::Push, pool.intern(Int32, "1")};
+    Instruction add{2, OpCode::Add, ConstantPool::kNone};
+    std::ostringstream sink;
+    vm wrapping(sink);
+    vm checked(sink);
+
+    checked.setCheckedArithmetic(true);
+    std::cout << "\n== checked arithmetic, " << count << " int32 adds ==\n";
+    wrapping.executeInstruction(push, pool);
+    checked.executeInstruction(push, pool);
+    double wrapMs = m_time([&]{
+        for (size_t i = 0; i < count; ++i)
+        {
+            wrapping.executeInstruction(push, pool);
+            wrapping.executeInstruction(add, pool);
+        }
+    });
+    double checkedMs = m_time([&]{
+        for (size_t i = 0; i < count; ++i)
+        {
+            checked.executeInstruction(push, pool);
+            checked.executeInstruction(add, pool);
+        }
+    });
+    std::cout << "  wrapping: " << wrapMs << " ms\n"
+              << "  checked:  " << checkedMs << " ms\n";
+}
+
+/* Growth cost of `count` pushes: total time and the slowest single push,
+ * against the pair of vectors the stack used to be. */
+static void benchStackGrowth(size_t count)
+{
+    using Clock = std::chrono::steady_clock;
+    std::vector<uint8_t> tags;
+    std::vector<OperandValue> values;
+    OperandStack chunked;
+    OperandValue v{};
+    double vectorWorst = 0;
+    double chunkedWorst = 0;
+
+    std::cout << "\n== stack growth, " << count << " pushes ==\n";
+    double vectorMs = m_time([&]{
+        for (size_t i = 0; i < count; ++i)
+        {
+            auto start = Clock::now();
+            v.i = static_cast<int64_t>(i);
+            tags.push_back(Int32);
+            values.push_back(v);
+            vectorWorst = std::max(vectorWorst, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+        }
+    });
+    double chunkedMs = m_time([&]{
+        for (size_t i = 0; i < count; ++i)
+        {
+            auto start = Clock::now();
+            v.i = static_cast<int64_t>(i);
+            chunked.push(Int32, v);
+            chunkedWorst = std::max(chunkedWorst, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+        }
+    });
+    std::cout << "  vector pair:    " << vectorMs << " ms, worst push " << vectorWorst << " ms\n"
+              << "  chunked stack:  " << chunkedMs << " ms, worst push " << chunkedWorst << " ms\n";
+}
+
+int main(int argc, char** argv)
+{
+    size_t count = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+
+    std::cout << "AbstractVM micro benchmarks\n";
+    benchDump(count);
+    benchReduce(count);
+    benchChecked(count);
+    benchDispatch(count);
+    benchFloatLiterals(count);
+    benchStackGrowth(count);
+    return 0;
+}
+#endif
@@ -2,10 +2,35 @@
 #include <limits>
 #include <string>
 #include <exception>
+#include <stdexcept>
+#include <sstream>
+#include <vector>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <typeinfo>
 
 #include "../operand/Operand.hpp"
 #include "../operand/OperandFactory.hpp"
+#include "../operand/Arithmetic.hpp"
 #include "../parser/InputReader.hpp"
+#include "../parser/Lexer.hpp"
+#include "../parser/Parser.hpp"
+#include "../vm/vm.hpp"
+#include "../vm/Runner.hpp"
+#include "../vm/SegmentRunner.hpp"
+#include "../vm/Session.hpp"
+#include "../vm/Watcher.hpp"
+#include "../trace/Trace.hpp"
+#include "../profiler/Profiler.hpp"
+#include "../stats/MemStats.hpp"
+#include "../vm/Checkpoint.hpp"
+#include "../vm/CompileCache.hpp"
+#include "../vm/OperandStack.hpp"
 
 #if defined(TEST_OPERAND_MAIN)
 static void banner(const std::string& name) {
@@ -330,6 +355,894 @@ int main() {
         delete r;
     });
 
+    banner("9) Native arithmetic (SoA stack path) matches Operand");
+    run_case("All type pairs and operators give the same type and text", []{
+        const eOperandType types[] = { Int8, Int16, Int32, Float, Double };
+        const char* literals[] = { "-7", "113", "-30001", "3.14159", "-2.718281828" };
+        const char ops[] = { '+', '-', '*', '/', '%' };
+        int mismatches = 0;
+
+        for (eOperandType lt : types)
+        {
+            for (eOperandType rt : types)
+            {
+                const IOperand* a = OperandFactory::createOperand(lt, literals[lt]);
+                const IOperand* b = OperandFactory::createOperand(rt, literals[rt]);
+                for (char op : ops)
+                {
+                    const IOperand* r = nullptr;
+                    switch (op)
+                    {
+                        case '+': r = *a + *b; break;
+                        case '-': r = *a - *b; break;
+                        case '*': r = *a * *b; break;
+                        case '/': r = *a / *b; break;
+                        default: r = *a % *b; break;
+                    }
+                    eOperandType nt;
+                    OperandValue nv = arith::apply(op, lt, OperandFactory::createValue(lt, literals[lt]),
+                                                   rt, OperandFactory::createValue(rt, literals[rt]), nt);
+                    char buf[kMaxValueChars];
+                    std::string text(buf, formatValue(buf, nt, nv));
+                    if (nt != r->getType() || text != r->toString())
+                    {
+                        std::cout << typeName(lt) << " " << op << " " << typeName(rt) << ": "
+                                  << r->toString() << " vs " << text << "\n";
+                        mismatches++;
+                    }
+                    delete r;
+                }
+                delete a;
+                delete b;
+            }
+        }
+        if (mismatches)
+            throw std::runtime_error(std::to_string(mismatches) + " mismatches");
+    });
+
+    run_case("Kernel table matches arith::apply for every cell", []{
+        const eOperandType types[] = { Int8, Int16, Int32, Float, Double };
+        const char* literals[] = { "-7", "113", "-30001", "3.14159", "-2.718281828" };
+        int mismatches = 0;
+
+        for (eOperandType lt : types)
+        {
+            for (eOperandType rt : types)
+            {
+                OperandValue l = OperandFactory::createValue(lt, literals[lt]);
+                OperandValue r = OperandFactory::createValue(rt, literals[rt]);
+                for (size_t op = 0; op < arith::kOpCount; ++op)
+                {
+                    eOperandType at;
+                    OperandValue a = arith::apply(arith::kOpChars[op], lt, l, rt, r, at);
+                    OperandValue k = arith::kernelFor(lt, rt, static_cast<arith::Op>(op))(l, r);
+                    char bufA[kMaxValueChars];
+                    char bufK[kMaxValueChars];
+                    if (at != arith::promote(lt, rt)
+                        || std::string(bufA, formatValue(bufA, at, a)) != std::string(bufK, formatValue(bufK, at, k)))
+                    {
+                        std::cout << typeName(lt) << " " << arith::kOpChars[op] << " " << typeName(rt) << "\n";
+                        mismatches++;
+                    }
+                }
+            }
+        }
+        if (mismatches)
+            throw std::runtime_error(std::to_string(mismatches) + " mismatches");
+    });
+
+    banner("10) Error channel matches the exceptions");
+    run_case("Each failing line yields the same text and exception type", []{
+        const char* lines[] = { "push int8(300)", "push int16(-40000)", "foo", "push int32(1", "&",
+                                "\"abc", "pop", "add", "push float(1)", "sum int32(0)", "assert int8(1)",
+                                "push int32(5)", "push int32(0)", "div", "print", "load int8(\"/nonexistent\")" };
+        std::ostringstream out;
+        vm tryVm(out);
+        vm throwVm(out);
+        ConstantPool pool;
+        size_t no = 0;
+        int mismatches = 0;
+
+        for (const char* text : lines)
+        {
+            Line line{++no, text};
+            Expected<std::vector<Token>> tokens = Lexer::tryTokenize(line);
+            Expected<Instruction> instr = tokens ? Parser::tryParseInstruction(*tokens, pool) : Expected<Instruction>(tokens.error());
+            Error err = instr ? tryVm.tryExecute(*instr, pool) : instr.error();
+            std::string thrown;
+            try {
+                throwVm.executeInstruction(Parser::parseInstruction(Lexer::tokenize(line), pool), pool);
+            } catch (const AVMException& e) {
+                thrown = e.what();
+                try {
+                    err.raise();
+                } catch (const AVMException& r) {
+                    if (typeid(r) != typeid(e))
+                        thrown += " (type differs)";
+                }
+            }
+            std::string got = err.failed() ? err.message() : "";
+            if (got != thrown)
+            {
+                std::cout << text << ": '" << got << "' vs '" << thrown << "'\n";
+                mismatches++;
+            }
+        }
+        if (mismatches)
+            throw std::runtime_error(std::to_string(mismatches) + " mismatches");
+    });
+
+    banner("11) Constant pool");
+    run_case("Identical literals share one pre-converted entry", []{
+        ConstantPool pool;
+        uint32_t a = pool.intern(Int16, "-300");
+        uint32_t b = pool.intern(Int16, "-300");
+        uint32_t c = pool.intern(Int32, "-300");
+        uint32_t d = pool.internText(Int16, "-300");
+
+        if (a != b || a == c || a == d || pool.size() != 3)
+            throw std::runtime_error("unexpected indices");
+        if (pool[a].type != Int16 || pool[a].value.i != -300 || pool[a].error.failed())
+            throw std::runtime_error("wrong value");
+    });
+    run_case("Out-of-range literal raises when its instruction runs", []{
+        ConstantPool pool;
+        std::ostringstream out;
+        vm machine(out);
+        Instruction bad = Parser::parseInstruction(Lexer::tokenize(Line{1, "push int8(300)"}), pool);
+        machine.executeInstruction(bad, pool);
+    }, true);
+
+    banner("12) Float literal fast path");
+    run_case("Float and double literals convert exactly as strtold", []{
+        std::vector<std::string> literals = {
+            "0.1", "-0.0", "0.5", "16777217.0", "9007199254740993.0", "3.4028234663852886e38",
+            "1.00000005960464477539", "0.000000000000000000000000000001", "9999999999999999999.9",
+            "123456789012345678.9", "-2.718281828459045235360287", "340282356779733661637539395458142568448.0"
+        };
+        uint64_t seed = 99;
+        for (int i = 0; i < 100000; ++i)
+        {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            std::string s = (seed >> 63) ? "-" : "";
+            s += std::to_string((seed >> 20) % 100000000);
+            s += '.';
+            s += std::to_string((seed >> 3) % 10000000000ULL);
+            literals.push_back(s);
+        }
+
+        int mismatches = 0;
+        for (const std::string& s : literals)
+        {
+            long double ref = std::strtold(s.c_str(), nullptr);
+            Expected<OperandValue> d = OperandFactory::tryCreateValue(Double, s);
+            Expected<OperandValue> f = OperandFactory::tryCreateValue(Float, s);
+            bool floatInRange = ref >= -std::numeric_limits<float>::max() && ref <= std::numeric_limits<float>::max();
+            if (!d || d.value().d != static_cast<double>(ref) || std::signbit(d.value().d) != std::signbit(ref))
+                mismatches++;
+            if (floatInRange != f.has_value() || (f && f.value().f != static_cast<float>(ref)))
+                mismatches++;
+        }
+        if (mismatches)
+            throw std::runtime_error(std::to_string(mismatches) + " mismatches");
+    });
+
+    banner("13) Assembler and Runner");
+    run_case("Runner waits for a forward label, then follows it", []{
+        Assembler code;
+        std::ostringstream out;
+        vm machine(out);
+        Runner runner(machine, code);
+        const char* lines[] = { "push int8(1)", "jnz done", "push int8(2)", "label done", "exit" };
+
+        for (size_t i = 0; i < 5; ++i)
+        {
+            code.append(Line{i + 1, lines[i]});
+            Error err = runner.run();
+            if (err.failed())
+                err.raise();
+            if (i == 2 && (runner.keepFrom() != 1 || machine.halted()))
+                throw std::runtime_error("did not wait at the jump");
+        }
+        if (!machine.halted() || code.pending())
+            throw std::runtime_error("did not reach exit");
+    });
+    run_case("Executed lines before the first label are discarded", []{
+        Assembler code;
+        std::ostringstream out;
+        vm machine(out);
+        Runner runner(machine, code);
+
+        code.append(Line{1, "push int32(0)"});
+        code.append(Line{2, "label again"});
+        code.append(Line{3, "repeat int32(4)"});
+        code.append(Line{4, "end"});
+        runner.run();
+        code.discardBefore(runner.keepFrom());
+        if (code.end() != 4 || code.at(1).op != OpCode::Label || code.at(2).target != 4)
+            throw std::runtime_error("wrong window");
+    });
+    run_case("Repeated lines reuse their parse with their own line number", []{
+        Assembler code;
+        const char* lines[] = { "push int32(5)", "push int32(5)", "push int32(5) ; again", "push int8(5)",
+                                "load int32 \"a;b\"", "load int32 \"a;c\"" };
+
+        for (size_t i = 0; i < 6; ++i)
+            code.append(Line{i + 1, lines[i]});
+        for (size_t i = 0; i < 6; ++i)
+            if (code.at(i).line != static_cast<int>(i + 1))
+                throw std::runtime_error("line number not patched");
+        if (code.at(2).constant != code.at(0).constant || code.at(3).constant == code.at(0).constant
+            || code.constants()[code.at(5).constant].literal != "a;c")
+            throw std::runtime_error("wrong constant reused");
+    });
+
+    banner("14) Checkpoints");
+    run_case("Snapshot round-trips and rejects a flipped byte", []{
+        const std::string path = (std::filesystem::temp_directory_path() / "avm_test.ckpt").string();
+        Snapshot s{1234, 60, 0xabcdef, 56, 7, 9, 3, 5, {Runner::Loop{4, 8, 11}}, {Int8, Double}, {}};
+        s.values.resize(2);
+        s.values[0].i = -3;
+        s.values[1].d = 2.5;
+        Checkpoint::save(path, s);
+
+        Snapshot r = Checkpoint::load(path);
+        if (r.inputSize != 1234 || r.inputEnd != 60 || r.inputHash != 0xabcdef || r.windowOffset != 56 || r.windowLine != 7 || r.lastLine != 9 || r.base != 3
+            || r.pc != 5 || r.loops.size() != 1 || r.loops[0].remaining != 11 || r.tags != s.tags
+            || r.values[0].i != -3 || r.values[1].d != 2.5)
+            throw std::runtime_error("fields differ");
+
+        std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(20);
+        f.put('\x7f');
+        f.close();
+        try
+        {
+            Checkpoint::load(path);
+        }
+        catch (const InvalidValue&)
+        {
+            std::filesystem::remove(path);
+            return;
+        }
+        throw std::runtime_error("corruption not detected");
+    });
+
+    run_case("Resume refuses an input edited without changing its size", []{
+        const std::string path = (std::filesystem::temp_directory_path() / "avm_test_resume.avm").string();
+        const std::string source = "push int32(7)\npush int32(8)\nadd\n";
+        auto resumeOn = [&](const std::string& text) {
+            std::ofstream(path, std::ios::trunc) << text;
+            std::ostringstream out;
+            vm machine(out);
+            Assembler code;
+            Runner runner(machine, code);
+            inputReader input(path, false);
+            Checkpoint checkpoint(path, 0, text.size());
+            checkpoint.resume(path + ".ckpt", input, code, runner, machine);
+        };
+
+        std::ofstream(path, std::ios::trunc) << source;
+        {
+            std::ostringstream out;
+            vm machine(out);
+            Assembler code;
+            Runner runner(machine, code);
+            inputReader input(path, false);
+            Checkpoint checkpoint(path, 1, source.size());
+            input.readProgram(10);
+            for (Line line = input.getLine(); line.no != 0; line = input.getLine())
+            {
+                code.append(line);
+                checkpoint.run(runner, code, machine, line);
+            }
+        }
+        resumeOn(source);
+        try
+        {
+            resumeOn("push int32(6)\npush int32(8)\nadd\n");
+        }
+        catch (const InvalidValue&)
+        {
+            std::filesystem::remove(path);
+            std::filesystem::remove(path + ".ckpt");
+            return;
+        }
+        throw std::runtime_error("edited input resumed");
+    });
+
+    banner("15) Compile cache");
+    run_case("Cached program runs like the compiled one and rejects a flipped byte", []{
+        const std::filesystem::path dir = std::filesystem::temp_directory_path() / "avm_test_cache";
+        const std::string source = "repeat int32(3)\npush int8(7)\nend\njmp skip\npush int8(300)\nlabel skip\nadd\nadd\ndump\nexit\n";
+        const std::string path = (dir / "prog.avm").string();
+        std::filesystem::create_directories(dir);
+        std::ofstream(path) << source;
+
+        auto run = [](const Program& program) {
+            std::ostringstream out;
+            vm machine(out);
+            Error err = Runner(machine, program.code()).run();
+            return err.failed() ? err.message() : out.str();
+        };
+        CompileCache cache(dir.string(), CompileCache::kDefaultMaxBytes);
+        const Hash128 key = CompileCache::key(reinterpret_cast<const unsigned char*>(source.data()), source.size());
+        Program compiled;
+        inputReader input(reinterpret_cast<const unsigned char*>(source.data()), source.size());
+        compiled.compile(input);
+        cache.store(key, compiled);
+
+        Program loaded;
+        if (!cache.load(key, loaded) || !loaded.hasExit() || run(loaded) != run(compiled) || run(loaded) != "21\n")
+            throw std::runtime_error("loaded program differs");
+
+        std::string entry;
+        for (const auto& e : std::filesystem::directory_iterator(dir))
+            if (e.path().extension() == ".avmc")
+                entry = e.path().string();
+        std::fstream f(entry, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(-12, std::ios::end);
+        f.put('\x7f');
+        f.close();
+        Program corrupt;
+        const bool hit = cache.load(key, corrupt);
+        std::filesystem::remove_all(dir);
+        if (hit)
+            throw std::runtime_error("corruption not detected");
+    });
+
+    banner("16) Chunked operand stack");
+    run_case("Values, swaps and ranges span chunk boundaries", []{
+        OperandStack stack;
+        const size_t n = OperandStack::kChunkSize + 10;
+        OperandValue v{};
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            v.i = static_cast<int64_t>(i);
+            stack.push(i % 2 ? Int32 : Int16, v);
+        }
+        stack.swap(0, 20);
+        if (stack.valueAt(0).i != static_cast<int64_t>(n - 21) || stack.valueAt(20).i != static_cast<int64_t>(n - 1))
+            throw std::runtime_error("swap across chunks");
+        stack.swap(0, 20);
+
+        size_t runs = 0;
+        int64_t expected = 5;
+        stack.forRange(5, n, [&](const uint8_t* tags, const OperandValue* values, size_t len) {
+            runs++;
+            for (size_t i = 0; i < len; ++i, ++expected)
+                if (values[i].i != expected || tags[i] != (expected % 2 ? Int32 : Int16))
+                    throw std::runtime_error("forRange out of order");
+        });
+        if (runs != 2 || expected != static_cast<int64_t>(n))
+            throw std::runtime_error("forRange runs");
+
+        for (size_t i = 0; i < 11; ++i)
+            stack.pop();
+        for (int round = 0; round < 3; ++round)
+        {
+            stack.copyToTop(0);
+            stack.copyToTop(0);
+            stack.pop();
+            stack.pop();
+        }
+        if (stack.size() != n - 11 || stack.valueAt(0).i != static_cast<int64_t>(n - 12)
+            || stack.valueAt(1).i != static_cast<int64_t>(n - 13))
+            throw std::runtime_error("boundary pops");
+    });
+
+    run_case("A stack over its memory budget spills and reads back", []{
+        OperandStack spilling;
+        OperandStack plain;
+        const size_t n = OperandStack::kChunkSize * 5 + 3;
+        OperandValue v{};
+
+        spilling.setMemoryBudget(0);
+        for (size_t i = 0; i < n; ++i)
+        {
+            v.d = static_cast<double>(i) + 0.5;
+            spilling.push(Double, v);
+            plain.push(Double, v);
+        }
+        std::ostringstream a;
+        std::ostringstream b;
+        spilling.dump(a);
+        plain.dump(b);
+        if (a.str() != b.str())
+            throw std::runtime_error("dump differs");
+        for (size_t i = n; i-- > 0;)
+        {
+            if (spilling.valueAt(0).d != static_cast<double>(i) + 0.5)
+                throw std::runtime_error("value lost at " + std::to_string(i));
+            spilling.pop();
+        }
+        if (!spilling.empty())
+            throw std::runtime_error("not empty");
+    });
+
+    run_case("A spill file that cannot be created is reported", []{
+        const char* saved = std::getenv("TMPDIR");
+        const std::string previous = saved ? saved : "";
+        std::ostringstream report;
+        std::streambuf* err = std::cerr.rdbuf(report.rdbuf());
+        OperandStack stack;
+        const size_t n = OperandStack::kChunkSize * 4;
+        OperandValue v{};
+
+        setenv("TMPDIR", "/nonexistent/avm", 1);
+        stack.setMemoryBudget(0);
+        for (size_t i = 0; i < n; ++i)
+        {
+            v.i = static_cast<int64_t>(i);
+            stack.push(Int32, v);
+        }
+        std::cerr.rdbuf(err);
+        if (saved)
+            setenv("TMPDIR", previous.c_str(), 1);
+        else
+            unsetenv("TMPDIR");
+
+        if (report.str().find("cannot create the stack spill file in /nonexistent/avm") == std::string::npos
+            || report.str().find("Warning", 1) != std::string::npos)
+            throw std::runtime_error("warned: " + report.str());
+        if (stack.size() != n || stack.valueAt(0).i != static_cast<int64_t>(n - 1))
+            throw std::runtime_error("values lost");
+    });
+
+    run_case("A dump across many chunks matches a serial one", []{
+        OperandStack stack;
+        const size_t n = OperandStack::kChunkSize * (OperandStack::kParallelDumpChunks + 2) + 17;
+        const eOperandType types[] = { Int8, Int16, Int32, Float, Double };
+        OperandValue v{};
+        std::string expected;
+        char buf[kMaxValueChars];
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            const eOperandType type = types[i % 5];
+            if (type == Float)
+                v.f = static_cast<float>(i) / 8;
+            else if (type == Double)
+                v.d = static_cast<double>(i) / 3;
+            else
+                v.i = static_cast<int64_t>(i % 100) - 50;
+            stack.push(type, v);
+        }
+        for (size_t i = 0; i < n; ++i)
+        {
+            expected.append(buf, formatValue(buf, stack.typeAt(i), stack.valueAt(i)));
+            expected += '\n';
+        }
+        for (unsigned jobs : { 1u, 3u, 8u })
+        {
+            std::ostringstream out;
+            stack.dump(out, jobs);
+            if (out.str() != expected)
+                throw std::runtime_error("dump on " + std::to_string(jobs) + " jobs differs");
+        }
+    });
+
+    banner("17) Parallel segments");
+    /* Blocks of pushes folded by a sum, with a print now and then, joined
+     * by adds at the end; `faultAt` puts a division by zero in one block. */
+    auto segmentProgram = [](Assembler& code, int faultAt) {
+        const int blocks = 24;
+        const size_t block = SegmentRunner::kTargetSegment / 4;
+        size_t no = 0;
+
+        for (int b = 0; b < blocks; ++b)
+        {
+            for (size_t i = 0; i < block; ++i)
+                code.append(Line{++no, "push int32(" + std::to_string((b * 7 + i) % 100) + ")"});
+            code.append(Line{++no, "push int8(" + std::to_string(65 + b) + ")"});
+            code.append(Line{++no, "print"});
+            code.append(Line{++no, "pop"});
+            if (b == faultAt)
+            {
+                code.append(Line{++no, "push int32(0)"});
+                code.append(Line{++no, "div"});
+            }
+            code.append(Line{++no, "sum int32(" + std::to_string(block) + ")"});
+        }
+        for (int b = 1; b < blocks; ++b)
+            code.append(Line{++no, "add"});
+        code.append(Line{++no, "dump"});
+        code.close();
+    };
+    /* Runs to the end, stepping over errors, and returns output and errors. */
+    auto runAll = [](vm& machine, std::ostringstream& out, auto& runner) {
+        std::string errors;
+        for (Error err = runner.run(); err.failed(); err = runner.run())
+        {
+            err.appendTo(errors);
+            errors += '\n';
+        }
+        return out.str() + "--\n" + errors + "--\n" + std::to_string(machine.stack().size());
+    };
+
+    run_case("Segments splice back into the sequential result", [&]{
+        Assembler code;
+        segmentProgram(code, -1);
+        if (!SegmentRunner::straightLine(code) || SegmentRunner::analyze(code).size() < 4)
+            throw std::runtime_error("no segments found");
+
+        std::ostringstream a;
+        std::ostringstream b;
+        vm plain(a);
+        vm split(b);
+        Runner runner(plain, code);
+        SegmentRunner segments(split, code, 4);
+        if (runAll(plain, a, runner) != runAll(split, b, segments))
+            throw std::runtime_error("results differ");
+    });
+
+    run_case("A segment that fails reruns in program order", [&]{
+        Assembler code;
+        segmentProgram(code, 9);
+
+        std::ostringstream a;
+        std::ostringstream b;
+        vm plain(a);
+        vm split(b);
+        Runner runner(plain, code);
+        SegmentRunner segments(split, code, 3);
+        const std::string expected = runAll(plain, a, runner);
+        if (expected.find("Division by zero") == std::string::npos || expected != runAll(split, b, segments))
+            throw std::runtime_error("results differ");
+    });
+
+    run_case("Control flow keeps a program on one core", []{
+        Assembler code;
+        code.append(Line{1, "push int32(1)"});
+        code.append(Line{2, "label top"});
+        code.append(Line{3, "exit"});
+        code.close();
+        if (SegmentRunner::straightLine(code))
+            throw std::runtime_error("label not seen");
+    });
+
+    banner("18) Lazy evaluation");
+    /* Runs `lines` eagerly and lazily, stepping over errors, and compares
+     * output, errors and the final stack. */
+    auto sameLazy = [](const std::vector<std::string>& lines) {
+        std::string results[2];
+        for (int lazy = 0; lazy < 2; ++lazy)
+        {
+            Assembler code;
+            std::ostringstream out;
+            vm machine(out);
+            Runner runner(machine, code);
+
+            machine.setLazy(lazy);
+            for (size_t i = 0; i < lines.size(); ++i)
+                code.append(Line{i + 1, lines[i]});
+            code.close();
+            for (Error err = runner.run(); err.failed(); err = runner.run())
+            {
+                err.appendTo(results[lazy]);
+                results[lazy] += '\n';
+            }
+            results[lazy] += out.str() + "--\n";
+            machine.stack().dump(out);
+            results[lazy] += out.str();
+        }
+        if (results[0] != results[1])
+            throw std::runtime_error("lazy run differs:\n" + results[1]);
+    };
+
+    run_case("Deferred arithmetic and stack moves match an eager run", [&]{
+        sameLazy({ "push int32(7)", "push int8(-3)", "sub", "push double(0.5)", "over", "sub", "rot", "swap",
+                   "dup", "push int16(4)", "div", "push int32(9)", "mod", "push int8(5)", "push int8(6)", "sub",
+                   "pop", "dump", "push int8(100)", "push int8(100)", "add", "assert int8(-56)" });
+    });
+
+    run_case("Errors stay in order and leave the stack as eagerly", [&]{
+        sameLazy({ "push int32(5)", "push int32(2)", "push int32(2)", "sub", "div", "push int8(1)", "add", "pop",
+                   "pop", "pop", "push int8(65)", "push int8(1)", "mul", "print", "push int8(300)", "mod",
+                   "push int32(0)", "add", "dump" });
+    });
+
+    run_case("Loops and jump conditions see computed values", [&]{
+        sameLazy({ "push int32(3)", "label top", "push int32(1)", "sub", "dup", "jnz top", "repeat int32(3)",
+                   "push int32(2)", "push int32(2)", "mul", "pop", "end", "dump" });
+    });
+
+    run_case("Values left at exit are never computed", []{
+        Assembler code;
+        std::ostringstream out;
+        vm machine(out);
+        Runner runner(machine, code);
+        const char* lines[] = { "push int32(1)", "push int32(2)", "add", "exit" };
+
+        machine.setLazy(true);
+        for (size_t i = 0; i < 4; ++i)
+            code.append(Line{i + 1, lines[i]});
+        if (runner.run().failed() || !machine.halted())
+            throw std::runtime_error("did not exit");
+        const vm& observed = machine;
+        if (!observed.stack().empty() || machine.stack().size() != 1 || machine.stack().valueAt(0).i != 3)
+            throw std::runtime_error("value computed before it was observed");
+    });
+
+    run_case("Deferred values count towards the peak stack depth", []{
+        const size_t n = MemStats::peakStackDepth() + 1000;
+        std::ostringstream out;
+        vm machine(out);
+        ConstantPool pool;
+        const Instruction push{1, OpCode::Push, pool.intern(Int32, "1")};
+
+        machine.setLazy(true);
+        for (size_t i = 0; i < n; ++i)
+            machine.executeInstruction(push, pool);
+        if (MemStats::peakStackDepth() != n || machine.stack().size() != n)
+            throw std::runtime_error("peak " + std::to_string(MemStats::peakStackDepth()) + ", expected "
+                                     + std::to_string(n));
+    });
+
+    banner("19) Watch mode");
+    run_case("An edit re-runs from the last mark before it", []{
+        const std::string path = (std::filesystem::temp_directory_path() / "avm_test_watch.avm").string();
+        /* 25 blocks of 1000 lines, each printing its letter and leaving
+         * one value behind, so marks (every 10000 lines) hold a stack. */
+        auto write = [&](char edited) {
+            std::ofstream f(path, std::ios::trunc);
+            for (int b = 0; b < 25; ++b)
+            {
+                const char c = b == 15 ? edited : static_cast<char>('A' + b);
+                f << "push int8(" << static_cast<int>(c) << ")\nprint\npop\npush int32(" << b << ")\n";
+                for (int i = 0; i < 996; ++i)
+                    f << (i % 2 ? "pop\n" : "push int32(1)\n");
+            }
+            f << "dump\nexit\n";
+        };
+        auto expected = [](char edited) {
+            std::string out;
+            for (int b = 0; b < 25; ++b)
+                out += std::string(1, b == 15 ? edited : static_cast<char>('A' + b)) + "\n";
+            for (int b = 24; b >= 0; --b)
+                out += std::to_string(b) + "\n";
+            return out;
+        };
+        auto capture = [](Watcher& w, size_t keep, bool& ok) {
+            std::ostringstream out;
+            std::streambuf* saved = std::cout.rdbuf(out.rdbuf());
+            ok = w.run(keep);
+            std::cout.rdbuf(saved);
+            return out.str();
+        };
+        Watcher w(path, false, 0);
+        bool ok;
+
+        write('P');
+        if (w.unchangedMarks() != 0 || capture(w, 0, ok) != expected('P') || !ok)
+            throw std::runtime_error("first run");
+        if (w.unchangedMarks() != 2)
+            throw std::runtime_error("marks not kept");
+
+        write('Z');
+        const size_t keep = w.unchangedMarks();
+        if (keep != 1 || w.restartLine(keep) != 10001)
+            throw std::runtime_error("wrong restart point");
+        if (capture(w, keep, ok) != expected('Z') || !ok)
+            throw std::runtime_error("replayed output differs");
+
+        std::fstream f(path, std::ios::in | std::ios::out);
+        f.seekp(10);
+        f.put('7');
+        f.close();
+        if (w.unchangedMarks() != 0)
+            throw std::runtime_error("edit before the first mark not seen");
+        std::filesystem::remove(path);
+    });
+
+    banner("20) Trace ring");
+    run_case("A full ring with no writer drops and counts instead of hanging", []{
+        TraceRing ring(0);
+        const size_t capacity = size_t(1) << 16;
+        const TraceEvent ev{1, 0, 0, 0, 0, 0, {0, 0, 0}};
+
+        for (size_t i = 0; i < capacity + 1000; ++i)
+            ring.push(ev);
+        if (ring.dropped() != 1000)
+            throw std::runtime_error("dropped " + std::to_string(ring.dropped()));
+    });
+
+    banner("21) Profiler output");
+    run_case("Samples are written as collapsed stacks per line range", []{
+        const std::string path = (std::filesystem::temp_directory_path() / "avm_test.folded").string();
+        std::ostringstream report;
+        std::streambuf* saved = std::cerr.rdbuf(report.rdbuf());
+        {
+            Profiler profiler(path, "prog.avm", 200);
+            volatile uint64_t sink = 0;
+            for (int line : { 7, 250 })
+            {
+                Profiler::setLine(line);
+                const std::clock_t until = std::clock() + CLOCKS_PER_SEC / 20;
+                while (std::clock() < until)
+                    sink = sink + 1;
+            }
+        }
+        std::cerr.rdbuf(saved);
+
+        std::ifstream in(path);
+        std::string text;
+        bool seen7 = false;
+        bool seen250 = false;
+        while (std::getline(in, text))
+        {
+            const size_t space = text.rfind(' ');
+            const std::string stack = text.substr(0, space);
+            if (space == std::string::npos || std::stoull(text.substr(space + 1)) == 0)
+                throw std::runtime_error("bad count: " + text);
+            seen7 = seen7 || stack == "prog.avm;lines 1-10;line 7";
+            seen250 = seen250 || stack == "prog.avm;lines 241-250;line 250";
+            if (stack != "prog.avm;lines 1-10;line 7" && stack != "prog.avm;lines 241-250;line 250"
+                && stack != "prog.avm;(front-end)")
+                throw std::runtime_error("unexpected stack: " + text);
+        }
+        std::filesystem::remove(path);
+        if (!seen7 || !seen250 || report.str().find("samples written to") == std::string::npos)
+            throw std::runtime_error("missing samples");
+    });
+
+    run_case("A SIGPROF still pending when the profiler stops is discarded", []{
+        const std::string path = (std::filesystem::temp_directory_path() / "avm_test_pending.folded").string();
+        std::ostringstream report;
+        std::streambuf* saved = std::cerr.rdbuf(report.rdbuf());
+        sigset_t prof;
+        sigset_t pending;
+
+        sigemptyset(&prof);
+        sigaddset(&prof, SIGPROF);
+        pthread_sigmask(SIG_BLOCK, &prof, nullptr);
+        {
+            Profiler profiler(path, "prog.avm", 200);
+            volatile uint64_t sink = 0;
+            const std::clock_t until = std::clock() + CLOCKS_PER_SEC / 50;
+            while (std::clock() < until)
+                sink = sink + 1;
+        }
+        sigpending(&pending);
+        pthread_sigmask(SIG_UNBLOCK, &prof, nullptr);
+        std::cerr.rdbuf(saved);
+        std::filesystem::remove(path);
+        if (sigismember(&pending, SIGPROF))
+            throw std::runtime_error("SIGPROF left pending");
+    });
+
+    banner("22) Memory stats");
+    run_case("Allocations are charged to the subsystem in scope", []{
+        MemStats::enable();
+        const MemCounters& lexer = MemStats::counters(MemSubsystem::Lexer);
+        const MemCounters& parser = MemStats::counters(MemSubsystem::Parser);
+        const uint64_t allocs = lexer.allocs;
+        const uint64_t frees = lexer.frees;
+        const uint64_t bytes = lexer.bytes;
+        const int64_t live = lexer.liveBytes;
+        const uint64_t parserAllocs = parser.allocs;
+        std::vector<char>* block;
+        {
+            MemScope scope(MemSubsystem::Lexer);
+            block = new std::vector<char>(1000);
+        }
+        {
+            MemScope scope(MemSubsystem::Parser);
+            delete block;
+        }
+#ifndef AVM_NO_MEMSTATS
+        if (lexer.allocs != allocs + 2 || lexer.frees != frees + 2 || lexer.bytes < bytes + 1000
+            || lexer.liveBytes != live || parser.allocs != parserAllocs)
+            throw std::runtime_error("wrong subsystem counts");
+#else
+        (void)allocs, (void)frees, (void)bytes, (void)live, (void)parserAllocs;
+#endif
+    });
+
+    run_case("The peak stack depth follows the deepest vm stack", []{
+        const size_t n = MemStats::peakStackDepth() + 1000;
+        std::ostringstream out;
+        vm machine(out);
+        ConstantPool pool;
+        const uint32_t one = pool.intern(Int32, "1");
+        const Instruction push{1, OpCode::Push, one};
+        const Instruction pop{2, OpCode::Pop, ConstantPool::kNone};
+
+        for (size_t i = 0; i < n; ++i)
+            machine.executeInstruction(push, pool);
+        machine.executeInstruction(pop, pool);
+        machine.executeInstruction(push, pool);
+        if (MemStats::peakStackDepth() != n)
+            throw std::runtime_error("peak " + std::to_string(MemStats::peakStackDepth()) + ", expected "
+                                     + std::to_string(n));
+    });
+
+    run_case("Concurrent depth notes keep the deepest", []{
+        const size_t base = MemStats::peakStackDepth() + 1;
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < 4; ++t)
+            threads.emplace_back([base, t] {
+                for (size_t i = 0; i < 100000; ++i)
+                    MemStats::noteStackDepth(base + (i * 4 + t) % 100000);
+            });
+        for (std::thread& t : threads)
+            t.join();
+        if (MemStats::peakStackDepth() != base + 99999)
+            throw std::runtime_error("peak " + std::to_string(MemStats::peakStackDepth()));
+    });
+
+    banner("23) Sessions");
+    run_case("A session suspends for input and resumes once fed", []{
+        std::string out;
+        Scheduler scheduler([&](Session&, const std::string& text) { out += text; }, 100, false);
+        Session& s = scheduler.add("a");
+
+        if (scheduler.run() != 1 || s.state() != SuspendReason::NeedInput || !s.waitingForInput())
+            throw std::runtime_error("not waiting for input");
+        scheduler.feed(s, "push int8(33)");
+        scheduler.feed(s, "print");
+        if (scheduler.run() != 1 || out != "!\n")
+            throw std::runtime_error("fed lines not run");
+        scheduler.feed(s, "exit");
+        if (scheduler.run() != 0 || !s.finished() || !s.ok())
+            throw std::runtime_error("exit not reached");
+    });
+
+    run_case("Exhausted slices resume round-robin", []{
+        std::vector<std::string> order;
+        Scheduler scheduler([&](Session& s, const std::string& text) {
+            order.push_back(s.name() + text.substr(0, 1) + (s.state() == SuspendReason::SliceExhausted ? "" : "!"));
+        }, 1, false);
+        for (const char* name : { "a", "b" })
+        {
+            Session& s = scheduler.add(name);
+            for (const char* line : { "push int8(49)", "print", "print", "print", "exit" })
+                scheduler.feed(s, line);
+            scheduler.close(s);
+        }
+        scheduler.run();
+
+        const std::vector<std::string> expected = { "a1", "b1", "a1", "b1", "a1", "b1" };
+        if (order != expected)
+            throw std::runtime_error("resume order differs");
+    });
+
+    run_case("A full output buffer suspends the session", []{
+        std::vector<SuspendReason> reasons;
+        size_t bytes = 0;
+        Scheduler scheduler([&](Session& s, const std::string& text) {
+            reasons.push_back(s.state());
+            bytes += text.size();
+        }, 1000000, false);
+        Session& s = scheduler.add("a");
+        for (const char* line : { "repeat int32(40000)", "push int8(1)", "end", "dump", "exit" })
+            scheduler.feed(s, line);
+        scheduler.close(s);
+        scheduler.run();
+
+        if (reasons.size() != 1 || reasons[0] != SuspendReason::OutputFull || bytes != 80000 || !s.ok())
+            throw std::runtime_error("no OutputFull suspension");
+    });
+
+    run_case("An exception that escapes a session is kept", []{
+        SessionTask task = []() -> SessionTask {
+            throw std::runtime_error("out of memory");
+            co_return;
+        }();
+        if (task.resume() != SuspendReason::Done || !task.exception())
+            throw std::runtime_error("exception lost");
+        try
+        {
+            std::rethrow_exception(task.exception());
+        }
+        catch (const std::runtime_error& e)
+        {
+            if (std::string(e.what()) != "out of memory")
+                throw std::runtime_error("wrong exception kept");
+        }
+    });
+
     banner("DONE");
     return 0;
 }
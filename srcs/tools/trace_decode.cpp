@@ -0,0 +1,52 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "../trace/Trace.hpp"
+#include "../vm/vm.hpp"
+
+/* Turns a binary trace written by `abstract_vm --trace <file>` into text,
+ * one event per line. */
+
+static const char* m_type(uint8_t t)
+{
+    if (t > None)
+        return "?";
+    return typeName(static_cast<eOperandType>(t));
+}
+
+int main(int argc, char** argv)
+{
+    TraceFileHeader header;
+    TraceEvent ev;
+
+    if (argc != 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <trace_file>\n";
+        return 1;
+    }
+
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in.is_open())
+    {
+        std::cerr << "Failed to open file: " << argv[1] << "\n";
+        return 1;
+    }
+
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))
+        || std::memcmp(header.magic, "AVMTRACE", sizeof(header.magic)) != 0
+        || header.version != 1 || header.eventSize != sizeof(TraceEvent))
+    {
+        std::cerr << "Not an AVM trace file (or unsupported version): " << argv[1] << "\n";
+        return 1;
+    }
+
+    while (in.read(reinterpret_cast<char*>(&ev), sizeof(ev)))
+    {
+        std::cout << "[T" << ev.thread << "] line " << ev.line
+                  << " " << (ev.op <= static_cast<uint8_t>(OpCode::None) ? opName(static_cast<OpCode>(ev.op)) : "?")
+                  << " depth=" << ev.depth
+                  << " lhs=" << m_type(ev.lhs)
+                  << " rhs=" << m_type(ev.rhs) << '\n';
+    }
+    return 0;
+}
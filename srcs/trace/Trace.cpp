@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <unistd.h>
+#include "Trace.hpp"
+#include "../exception/Exception.hpp"
+
+std::mutex Tracer::s_mutex;
+std::vector<std::unique_ptr<TraceRing>> Tracer::s_rings;
+std::thread Tracer::s_writer;
+std::atomic<bool> Tracer::s_stop{false};
+int Tracer::s_fd = -1;
+
+static void m_writeAll(int fd, const void* data, size_t len)
+{
+    const char* p = static_cast<const char*>(data);
+    while (len > 0)
+    {
+        ssize_t n = ::write(fd, p, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        p += n;
+        len -= static_cast<size_t>(n);
+    }
+}
+
+TraceRing::TraceRing(uint16_t thread)
+    : _events(new TraceEvent[kCapacity]), _head(0), _stalled(false), _dropped(0), _tail(0), thread(thread)
+{
+}
+
+/* When the writer falls behind, the producer yields until a slot frees
+ * up, but gives up after kMaxWaitMs so a stalled writer cannot hang the
+ * VM; from then on it drops without waiting until the ring has room. */
+void TraceRing::push(const TraceEvent& ev)
+{
+    size_t head = _head.load(std::memory_order_relaxed);
+    if (head - _tail.load(std::memory_order_acquire) == kCapacity)
+    {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kMaxWaitMs);
+        while (head - _tail.load(std::memory_order_acquire) == kCapacity)
+        {
+            if (_stalled || std::chrono::steady_clock::now() >= deadline)
+            {
+                _stalled = true;
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            std::this_thread::yield();
+        }
+    }
+    _stalled = false;
+    _events[head & (kCapacity - 1)] = ev;
+    _head.store(head + 1, std::memory_order_release);
+}
+
+size_t TraceRing::drain(int fd)
+{
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    size_t head = _head.load(std::memory_order_acquire);
+    size_t count = head - tail;
+
+    while (tail != head)
+    {
+        size_t start = tail & (kCapacity - 1);
+        size_t chunk = std::min(head - tail, kCapacity - start);
+        m_writeAll(fd, &_events[start], chunk * sizeof(TraceEvent));
+        tail += chunk;
+    }
+    _tail.store(tail, std::memory_order_release);
+    return count;
+}
+
+TraceRing* Tracer::m_registerThread()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_rings.push_back(std::make_unique<TraceRing>(static_cast<uint16_t>(s_rings.size())));
+    s_ring = s_rings.back().get();
+    return s_ring;
+}
+
+/* Rings are never removed while tracing, so the writes happen outside
+ * the lock and registering a thread never waits on the disk. */
+size_t Tracer::m_drainAll()
+{
+    std::vector<TraceRing*> rings;
+    size_t total = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        for (auto& ring : s_rings)
+            rings.push_back(ring.get());
+    }
+    for (TraceRing* ring : rings)
+        total += ring->drain(s_fd);
+    return total;
+}
+
+void Tracer::m_writerLoop()
+{
+    while (!s_stop.load(std::memory_order_acquire))
+    {
+        if (m_drainAll() == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    m_drainAll();
+}
+
+void Tracer::start(const std::string& path)
+{
+    TraceFileHeader header;
+
+    s_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (s_fd < 0)
+        throw FailedToOpenFile(path);
+
+    std::memcpy(header.magic, "AVMTRACE", sizeof(header.magic));
+    header.version = 1;
+    header.eventSize = sizeof(TraceEvent);
+    m_writeAll(s_fd, &header, sizeof(header));
+
+    s_stop.store(false, std::memory_order_relaxed);
+    s_writer = std::thread(&Tracer::m_writerLoop);
+    s_enabled.store(true, std::memory_order_release);
+}
+
+void Tracer::stop()
+{
+    if (!s_enabled.exchange(false))
+        return;
+    s_stop.store(true, std::memory_order_release);
+    s_writer.join();
+    ::close(s_fd);
+    s_fd = -1;
+
+    uint64_t dropped = 0;
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        for (auto& ring : s_rings)
+            dropped += ring->dropped();
+    }
+    if (dropped > 0)
+        std::cerr << "Trace: " << dropped << " events dropped while the writer was behind\n";
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Structured tracing.
+ * Trace points write fixed-size binary events into a per-thread
+ * single-producer/single-consumer ring. A background thread started by
+ * Tracer::start() drains every ring into the trace file, so the VM thread
+ * never formats text or does I/O. Decode with avm_trace_decode.
+ *
+ * A full ring makes its producer wait for the writer, but for at most
+ * kMaxWaitMs: after that events are dropped and counted until it has room
+ * again, and Tracer::stop() reports how many were lost.
+ *
+ * Build with -DAVM_NO_TRACE to compile the trace points out entirely.
+ */
+
+struct TraceEvent
+{
+    uint32_t line;
+    uint32_t depth;     /* stack depth before the instruction */
+    uint16_t thread;    /* registration index of the emitting thread */
+    uint8_t op;         /* OpCode */
+    uint8_t lhs;        /* eOperandType of the second value, None if absent */
+    uint8_t rhs;        /* eOperandType of the top value, None if absent */
+    uint8_t pad[3];
+};
+static_assert(sizeof(TraceEvent) == 16, "TraceEvent must stay 16 bytes");
+
+struct TraceFileHeader
+{
+    char magic[8];      /* "AVMTRACE" */
+    uint32_t version;
+    uint32_t eventSize;
+};
+
+class TraceRing
+{
+    private:
+        static constexpr size_t kCapacity = 1 << 16;
+        static constexpr int kMaxWaitMs = 50;
+
+        std::unique_ptr<TraceEvent[]> _events;
+        alignas(64) std::atomic<size_t> _head; /* written by the producer */
+        bool _stalled;                          /* producer only: dropping since the ring filled */
+        std::atomic<uint64_t> _dropped;
+        alignas(64) std::atomic<size_t> _tail; /* written by the consumer */
+
+    public:
+        const uint16_t thread;
+
+        explicit TraceRing(uint16_t thread);
+
+        void push(const TraceEvent& ev);
+        size_t drain(int fd);
+        uint64_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+};
+
+class Tracer
+{
+    private:
+        inline static std::atomic<bool> s_enabled{false};
+        inline static thread_local TraceRing* s_ring = nullptr;
+
+        static std::mutex s_mutex;
+        static std::vector<std::unique_ptr<TraceRing>> s_rings;
+        static std::thread s_writer;
+        static std::atomic<bool> s_stop;
+        static int s_fd;
+
+        static TraceRing* m_registerThread();
+        static void m_writerLoop();
+        static size_t m_drainAll();
+
+        Tracer();
+        Tracer(const Tracer& other);
+        const Tracer& operator=(const Tracer& other);
+        ~Tracer();
+
+    public:
+        static void start(const std::string& path);
+        static void stop();
+
+        static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+        static void record(uint8_t op, uint32_t line, uint8_t lhs, uint8_t rhs, uint32_t depth)
+        {
+            TraceRing* ring = s_ring ? s_ring : m_registerThread();
+            ring->push(TraceEvent{line, depth, ring->thread, op, lhs, rhs, {0, 0, 0}});
+        }
+};
+
+#ifndef AVM_NO_TRACE
+  #define AVM_TRACE(op, line, lhs, rhs, depth) \
+    do { if (Tracer::enabled()) Tracer::record((op), (line), (lhs), (rhs), (depth)); } while(0)
+#else
+  #define AVM_TRACE(op, line, lhs, rhs, depth) do {} while(0)
+#endif
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+/* Native-endian binary encoding for checkpoint and cache files, which are
+ * only read back on the machine that wrote them. */
+template <typename T>
+inline void putBytes(std::string& out, const T& v)
+{
+    out.append(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+/* Bounds-checked reads: past the end, get() returns T{} and ok() turns
+ * false, so a truncated file is one check at the end. */
+class ByteReader
+{
+    private:
+        const char* _p;
+        const char* _end;
+        bool _ok;
+
+    public:
+        ByteReader(const char* data, size_t size) : _p(data), _end(data + size), _ok(true) {}
+
+        template <typename T>
+        T get()
+        {
+            T v{};
+            if (static_cast<size_t>(_end - _p) < sizeof(T))
+                _ok = false;
+            else
+                std::memcpy(&v, _p, sizeof(T));
+            _p += _ok ? sizeof(T) : 0;
+            return v;
+        }
+
+        std::string_view take(size_t n)
+        {
+            if (static_cast<size_t>(_end - _p) < n)
+            {
+                _ok = false;
+                return {};
+            }
+            std::string_view s(_p, n);
+            _p += n;
+            return s;
+        }
+
+        bool ok() const { return _ok; }
+        size_t remaining() const { return static_cast<size_t>(_end - _p); }
+};
@@ -0,0 +1,136 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Runs fn(i) for every i in [0, count) on up to `jobs` threads (0 picks
+ * the hardware concurrency). Indices are handed out dynamically, so
+ * uneven work items balance themselves. fn must not throw. */
+template <typename Fn>
+void parallelFor(size_t count, unsigned jobs, Fn fn)
+{
+    if (jobs == 0)
+        jobs = std::max(1u, std::thread::hardware_concurrency());
+    jobs = static_cast<unsigned>(std::min<size_t>(jobs, count));
+
+    if (jobs <= 1)
+    {
+        for (size_t i = 0; i < count; ++i)
+            fn(i);
+        return;
+    }
+
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> workers;
+    workers.reserve(jobs);
+    for (unsigned w = 0; w < jobs; ++w)
+    {
+        workers.emplace_back([&]() {
+            for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1))
+                fn(i);
+        });
+    }
+    for (std::thread& t : workers)
+        t.join();
+}
+
+/* parallelFor for many rounds in a row: the `jobs` - 1 helper threads are
+ * started once and the calling thread works as the last one, so a loop
+ * of small batches does not create and join threads every time. */
+class WorkerPool
+{
+    private:
+        std::vector<std::thread> _threads;
+        std::mutex _mutex;
+        std::condition_variable _wake;
+        std::condition_variable _idle;
+        std::function<void(size_t)> _fn;
+        size_t _count;
+        std::atomic<size_t> _next;
+        size_t _busy;           /* helpers still in the current round */
+        uint64_t _round;
+        bool _stop;
+
+        void m_drain()
+        {
+            for (size_t i = _next.fetch_add(1); i < _count; i = _next.fetch_add(1))
+                _fn(i);
+        }
+
+        void m_work()
+        {
+            uint64_t seen = 0;
+            std::unique_lock<std::mutex> lock(_mutex);
+
+            while (true)
+            {
+                _wake.wait(lock, [&] { return _stop || _round != seen; });
+                if (_stop)
+                    return;
+                seen = _round;
+                lock.unlock();
+                m_drain();
+                lock.lock();
+                if (--_busy == 0)
+                    _idle.notify_one();
+            }
+        }
+
+        WorkerPool(const WorkerPool& other);
+        const WorkerPool& operator=(const WorkerPool& other);
+
+    public:
+        /* `jobs` as for parallelFor. */
+        explicit WorkerPool(unsigned jobs) : _count(0), _next(0), _busy(0), _round(0), _stop(false)
+        {
+            if (jobs == 0)
+                jobs = std::max(1u, std::thread::hardware_concurrency());
+            for (unsigned w = 1; w < jobs; ++w)
+                _threads.emplace_back([this] { m_work(); });
+        }
+
+        ~WorkerPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stop = true;
+            }
+            _wake.notify_all();
+            for (std::thread& t : _threads)
+                t.join();
+        }
+
+        unsigned jobs() const { return static_cast<unsigned>(_threads.size() + 1); }
+
+        /* fn(i) for every i in [0, count); returns once all are done. */
+        template <typename Fn>
+        void run(size_t count, Fn fn)
+        {
+            if (_threads.empty() || count <= 1)
+            {
+                for (size_t i = 0; i < count; ++i)
+                    fn(i);
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _fn = std::ref(fn);
+                _count = count;
+                _next.store(0);
+                _busy = _threads.size();
+                ++_round;
+            }
+            _wake.notify_all();
+            m_drain();
+
+            std::unique_lock<std::mutex> lock(_mutex);
+            _idle.wait(lock, [&] { return _busy == 0; });
+            _fn = nullptr;
+        }
+};
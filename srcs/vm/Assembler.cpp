@@ -0,0 +1,255 @@
+#include <algorithm>
+#include "Assembler.hpp"
+#include "../parser/Lexer.hpp"
+#include "../parser/Parser.hpp"
+#include "../stats/MemStats.hpp"
+
+static const ErrorDesc m_duplicateLabel = { ErrorKind::Syntax, "Duplicate label: %s" };
+static const ErrorDesc m_undefinedLabel = { ErrorKind::Syntax, "Undefined label: %s" };
+static const ErrorDesc m_endWithoutRepeat = { ErrorKind::Syntax, "end without repeat" };
+static const ErrorDesc m_repeatWithoutEnd = { ErrorKind::Syntax, "repeat without end" };
+
+/* The part of a line the lexer reads: up to its comment, unless a quoted
+ * path before it may hold a ';'. */
+static std::string_view m_memoKey(const std::string& text)
+{
+    const size_t cut = text.find_first_of(";\"");
+    return std::string_view(text).substr(0, cut != std::string::npos && text[cut] == ';' ? cut : text.size());
+}
+
+Assembler::Assembler() : _base(0), _firstLabel(SIZE_MAX), _seen(kMaxMemoLines, 0), _memoHits(0), _memoMisses(0)
+{
+}
+
+Assembler::~Assembler()
+{
+    MemStats::noteLineMemo(_memoHits, _memoMisses);
+}
+
+Error Assembler::m_fault(Instruction& instr, const Error& error)
+{
+    instr.op = OpCode::Fault;
+    instr.constant = _constants.addError(error);
+    instr.target = Instruction::kUnlinked;
+    return error;
+}
+
+Error Assembler::m_link(Instruction& instr, size_t at)
+{
+    switch (instr.op)
+    {
+        case OpCode::Label:
+        {
+            const std::string& name = _constants[instr.constant].literal;
+            if (!_labels.emplace(name, at).second)
+                return m_fault(instr, Error(m_duplicateLabel, instr.line, 0, name));
+            _firstLabel = std::min(_firstLabel, at);
+            auto waiting = _forward.find(name);
+            if (waiting != _forward.end())
+            {
+                for (size_t jump : waiting->second)
+                    _code[jump - _base].target = at;
+                _forward.erase(waiting);
+            }
+            break;
+        }
+        case OpCode::Jmp:
+        case OpCode::Jz:
+        case OpCode::Jnz:
+        {
+            const std::string& name = _constants[instr.constant].literal;
+            auto label = _labels.find(name);
+            if (label != _labels.end())
+                instr.target = label->second;
+            else
+                _forward[name].push_back(at);
+            break;
+        }
+        case OpCode::Repeat:
+            _open.push_back(at);
+            break;
+        case OpCode::End:
+            if (_open.empty())
+                return m_fault(instr, Error(m_endWithoutRepeat, instr.line));
+            instr.target = _open.back();
+            _code[_open.back() - _base].target = at + 1;
+            _open.pop_back();
+            break;
+        default:
+            break;
+    }
+    return Error();
+}
+
+/* Only lines seen twice are kept, so a program of distinct lines pays
+ * for a hash and no allocation. A full memo starts over. */
+void Assembler::m_remember(std::string_view key, const Instruction& instr)
+{
+    const size_t hash = TextHash{}(key);
+    size_t& seen = _seen[hash % kMaxMemoLines];
+
+    if (seen != hash)
+    {
+        seen = hash;
+        return;
+    }
+    if (_memo.size() >= kMaxMemoLines)
+        _memo.clear();
+    _memo.emplace(key, instr);
+}
+
+Error Assembler::append(const Line& line)
+{
+    const std::string_view key = m_memoKey(line.text);
+    Instruction instr{static_cast<int>(line.no), OpCode::None, ConstantPool::kNone};
+    auto memo = _memo.find(key);
+
+    if (memo != _memo.end())
+    {
+        _memoHits++;
+        instr = memo->second;
+        instr.line = static_cast<int>(line.no);
+    }
+    else
+    {
+        _memoMisses++;
+        Expected<std::vector<Token>> tokens = [&] {
+            MemScope scope(MemSubsystem::Lexer);
+            return Lexer::tryTokenize(line);
+        }();
+        MemScope scope(MemSubsystem::Parser);
+        Expected<Instruction> parsed = tokens ? Parser::tryParseInstruction(*tokens, _constants)
+                                              : Expected<Instruction>(tokens.error());
+        if (!parsed)
+        {
+            _code.push_back(instr);
+            _offsets.push_back(line.offset);
+            return m_fault(_code.back(), parsed.error());
+        }
+        instr = *parsed;
+        if (key.size() <= kMaxMemoLineLength)
+            m_remember(key, instr);
+    }
+    if (instr.op == OpCode::None)
+        return Error();
+    _code.push_back(instr);
+    _offsets.push_back(line.offset);
+    return m_link(_code.back(), end() - 1);
+}
+
+Error Assembler::close()
+{
+    size_t firstAt = SIZE_MAX;
+    Error first;
+
+    auto fault = [&](size_t index, const ErrorDesc& desc, const std::string& detail) {
+        Instruction& instr = _code[index - _base];
+        Error err = m_fault(instr, Error(desc, instr.line, 0, detail));
+        if (index < firstAt)
+        {
+            firstAt = index;
+            first = err;
+        }
+    };
+    for (const auto& [name, jumps] : _forward)
+        for (size_t jump : jumps)
+            fault(jump, m_undefinedLabel, name);
+    for (size_t repeat : _open)
+        fault(repeat, m_repeatWithoutEnd, std::string());
+    _forward.clear();
+    _open.clear();
+    return first;
+}
+
+bool Assembler::linked(size_t index) const
+{
+    switch (at(index).op)
+    {
+        case OpCode::Jmp:
+        case OpCode::Jz:
+        case OpCode::Jnz:
+        case OpCode::Repeat:
+            return at(index).target != Instruction::kUnlinked;
+        default:
+            return true;
+    }
+}
+
+void Assembler::discardBefore(size_t index)
+{
+    index = std::min(index, _firstLabel);
+    if (!_open.empty())
+        index = std::min(index, _open.front());
+    if (index <= _base)
+        return;
+    _code.erase(_code.begin(), _code.begin() + static_cast<std::ptrdiff_t>(index - _base));
+    _offsets.erase(_offsets.begin(), _offsets.begin() + static_cast<std::ptrdiff_t>(index - _base));
+    _base = index;
+    if (_code.empty() && _constants.size() > kMaxConstants)
+    {
+        _constants.clear();
+        _memo.clear();
+    }
+}
+
+void Assembler::rebase(size_t base)
+{
+    if (_code.empty())
+        _base = base;
+}
+
+bool Assembler::save(std::string& out) const
+{
+    if (_base != 0 || pending())
+        return false;
+    putBytes(out, static_cast<uint64_t>(_code.size()));
+    for (const Instruction& instr : _code)
+    {
+        if (instr.op == OpCode::Fault)
+            return false;
+        putBytes(out, static_cast<int32_t>(instr.line));
+        putBytes(out, static_cast<uint8_t>(instr.op));
+        putBytes(out, instr.constant);
+        putBytes(out, static_cast<uint64_t>(instr.target));
+    }
+    return _constants.save(out);
+}
+
+bool Assembler::load(ByteReader& in)
+{
+    const uint64_t count = in.get<uint64_t>();
+
+    _code.clear();
+    _offsets.clear();
+    _labels.clear();
+    _forward.clear();
+    _open.clear();
+    _base = 0;
+    _firstLabel = SIZE_MAX;
+    _memo.clear();
+    if (count > in.remaining())
+        return false;
+    _code.reserve(count);
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        Instruction instr{0, OpCode::None, ConstantPool::kNone};
+        instr.line = in.get<int32_t>();
+        const uint8_t op = in.get<uint8_t>();
+        instr.constant = in.get<uint32_t>();
+        const uint64_t target = in.get<uint64_t>();
+        if (op >= static_cast<uint8_t>(OpCode::None) || (target > count && target != Instruction::kUnlinked))
+            return false;
+        instr.op = static_cast<OpCode>(op);
+        instr.target = static_cast<size_t>(target);
+        if (instr.op == OpCode::Label)
+            _firstLabel = std::min<size_t>(_firstLabel, i);
+        _code.push_back(instr);
+    }
+    _offsets.assign(_code.size(), 0);
+    if (!in.ok() || !_constants.load(in))
+        return false;
+    for (const Instruction& instr : _code)
+        if (instr.constant != ConstantPool::kNone && instr.constant >= _constants.size())
+            return false;
+    return true;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "vm.hpp"
+#include "../parser/InputReader.hpp"
+
+/* The instruction array a Runner executes from, built one line at a time.
+ * Lines are lexed, parsed and linked as they are appended: a jump gets its
+ * label's index, a repeat and its end get each other's. A line that fails
+ * becomes a Fault instruction reporting the error when execution reaches
+ * it, so errors still come out in program order.
+ *
+ * Indices are absolute (counted from the first line ever appended) and
+ * stay valid when the executed prefix is discarded. Nothing at or after
+ * the first label is ever discarded, since a jump may still go back.
+ */
+class Assembler
+{
+    private:
+        static constexpr size_t kMaxConstants = 10000;
+        static constexpr size_t kMaxMemoLines = 4096;
+        static constexpr size_t kMaxMemoLineLength = 64;
+
+        struct TextHash
+        {
+            using is_transparent = void;
+            size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+        };
+
+        std::vector<Instruction> _code;
+        std::vector<uint64_t> _offsets;     /* input offset of each one's line */
+        size_t _base;           /* absolute index of _code[0] */
+        ConstantPool _constants;
+        std::unordered_map<std::string, size_t> _labels;
+        std::unordered_map<std::string, std::vector<size_t>> _forward;     /* jumps waiting for a label */
+        std::vector<size_t> _open;      /* repeats waiting for their end */
+        size_t _firstLabel;
+        /* Parsed lines by text, so a repeated line skips the lexer and
+         * parser. Holds pool indices: cleared with the pool. */
+        std::unordered_map<std::string, Instruction, TextHash, std::equal_to<>> _memo;
+        std::vector<size_t> _seen;      /* hashes of lines seen once, by hash */
+        uint64_t _memoHits;
+        uint64_t _memoMisses;
+
+        Error m_link(Instruction& instr, size_t at);
+        Error m_fault(Instruction& instr, const Error& error);
+        void m_remember(std::string_view key, const Instruction& instr);
+
+        Assembler(const Assembler& other);
+        const Assembler& operator=(const Assembler& other);
+
+    public:
+        Assembler();
+        ~Assembler();
+
+        /* Lexes, parses and links one line. The Error is also kept as the
+         * line's Fault instruction; blank lines add nothing. A line seen
+         * before reuses its parsed instruction. */
+        Error append(const Line& line);
+        /* No more lines will come: jumps to labels never defined and
+         * repeats without an end become faults. Returns the first one. */
+        Error close();
+
+        /* False for a jump or repeat still waiting for its label or end. */
+        bool linked(size_t index) const;
+        /* True while a later line is needed to link an earlier one. */
+        bool pending() const { return !_forward.empty() || !_open.empty(); }
+
+        const Instruction& at(size_t index) const { return _code[index - _base]; }
+        size_t end() const { return _base + _code.size(); }
+        const Instruction& back() const { return _code.back(); }
+        bool empty() const { return _code.empty(); }
+        const ConstantPool& constants() const { return _constants; }
+        /* Input offset of the line instruction `index` came from. */
+        uint64_t offsetOf(size_t index) const { return _offsets[index - _base]; }
+        size_t base() const { return _base; }
+        /* Numbers the next instruction `base`; only while empty (resume). */
+        void rebase(size_t base);
+
+        /* Appends the code and its constants to `out` for the compile
+         * cache; false unless it is complete (nothing discarded, nothing
+         * pending) and free of faults. */
+        bool save(std::string& out) const;
+        /* Replaces everything with saved code, linked as it was. False if
+         * `in` is malformed. */
+        bool load(ByteReader& in);
+
+        /* Frees instructions before `index` that no jump can return to;
+         * empties the constant pool once no instruction is left. */
+        void discardBefore(size_t index);
+};
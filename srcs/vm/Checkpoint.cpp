@@ -0,0 +1,262 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "Checkpoint.hpp"
+#include "MappedFile.hpp"
+#include "../exception/Exception.hpp"
+#include "../utils/ByteIO.hpp"
+
+/* Layout: "AVMK", u32 version, the ten u64 fields of Snapshot (loop and
+ * stack counts in place of the vectors), the loops, the tag lane, the
+ * value lane, then an FNV-1a checksum of everything before it. */
+static const char m_magic[4] = { 'A', 'V', 'M', 'K' };
+static constexpr uint32_t kVersion = 2;
+
+uint64_t Checkpoint::hash(uint64_t h, const void* data, size_t len)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < len; ++i)
+    {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static uint64_t m_checksum(const char* data, size_t len)
+{
+    return Checkpoint::hash(Checkpoint::kFnvBasis, data, len);
+}
+
+/* The input's bytes before `end` as the reader hands them out: a last
+ * line without a newline still ends in one. */
+static uint64_t m_inputHash(const std::string& inputPath, uint64_t end)
+{
+    MappedFile file(inputPath, SIZE_MAX);
+    const size_t len = static_cast<size_t>(std::min<uint64_t>(end, file.size()));
+    const uint64_t h = Checkpoint::hash(Checkpoint::kFnvBasis, file.data(), len);
+
+    return end > len ? Checkpoint::hash(h, "\n", 1) : h;
+}
+
+[[noreturn]] static void m_corrupt(const std::string& path)
+{
+    throw InvalidValue("Corrupt checkpoint: " + path);
+}
+
+Checkpoint::Checkpoint(const std::string& inputPath, size_t every, uint64_t inputSize)
+    : _path(inputPath + ".ckpt"), _inputPath(inputPath), _every(every), _budget(every), _inputSize(inputSize),
+      _inputHash(kFnvBasis), _writer(0)
+{
+}
+
+Checkpoint::~Checkpoint()
+{
+    m_reap(true);
+}
+
+/* True once no writer is left running. */
+bool Checkpoint::m_reap(bool wait)
+{
+    int status = 0;
+
+    if (_writer <= 0)
+        return true;
+    if (waitpid(_writer, &status, wait ? 0 : WNOHANG) == 0)
+        return false;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        std::cerr << "Failed to write checkpoint " << _path << "\n";
+    _writer = 0;
+    return true;
+}
+
+Snapshot Checkpoint::capture(const Runner& runner, const Assembler& code, const vm& machine, const Line& last,
+                             uint64_t inputSize, uint64_t inputHash)
+{
+    Snapshot s;
+    const OperandStack& stack = machine.stack();
+
+    s.inputSize = inputSize;
+    s.inputEnd = last.offset + last.text.size() + 1;
+    s.inputHash = inputHash;
+    s.lastLine = last.no;
+    if (code.empty())
+    {
+        s.windowOffset = std::min<uint64_t>(last.offset + last.text.size() + 1, inputSize);
+        s.windowLine = last.no + 1;
+    }
+    else
+    {
+        s.windowOffset = code.offsetOf(code.base());
+        s.windowLine = static_cast<uint64_t>(code.at(code.base()).line);
+    }
+    s.base = code.base();
+    s.pc = runner.pc();
+    s.loops = runner.loops();
+    stack.forRange(0, stack.size(), [&](const uint8_t* tags, const OperandValue* values, size_t len) {
+        s.tags.insert(s.tags.end(), tags, tags + len);
+        s.values.insert(s.values.end(), values, values + len);
+    });
+    return s;
+}
+
+void Checkpoint::m_take(const Runner& runner, const Assembler& code, const vm& machine, const Line& last)
+{
+    if (!m_reap(false))
+        return;
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        int status = 0;
+        try
+        {
+            save(_path, capture(runner, code, machine, last, _inputSize, _inputHash));
+        }
+        catch (const std::exception&)
+        {
+            status = 1;
+        }
+        _exit(status);
+    }
+    if (pid > 0)
+        _writer = pid;
+    else
+        save(_path, capture(runner, code, machine, last, _inputSize, _inputHash));
+}
+
+Error Checkpoint::run(Runner& runner, const Assembler& code, const vm& machine, const Line& last)
+{
+    if (_every == 0)
+        return runner.run();
+    _inputHash = hash(hash(_inputHash, last.text.data(), last.text.size()), "\n", 1);
+
+    Error err = runner.run(_budget);
+    while (_budget == 0)
+    {
+        _budget = _every;
+        if (err.failed() || machine.halted())
+            break;
+        m_take(runner, code, machine, last);
+        err = runner.run(_budget);
+    }
+    return err;
+}
+
+void Checkpoint::save(const std::string& path, const Snapshot& s)
+{
+    std::string out;
+    const std::string tmp = path + ".tmp";
+
+    out.append(m_magic, sizeof(m_magic));
+    putBytes(out, kVersion);
+    for (uint64_t v : { s.inputSize, s.inputEnd, s.inputHash, s.windowOffset, s.windowLine, s.lastLine, s.base, s.pc,
+                        static_cast<uint64_t>(s.loops.size()), static_cast<uint64_t>(s.tags.size()) })
+        putBytes(out, v);
+    for (const Runner::Loop& loop : s.loops)
+    {
+        putBytes(out, static_cast<uint64_t>(loop.start));
+        putBytes(out, static_cast<uint64_t>(loop.end));
+        putBytes(out, loop.remaining);
+    }
+    out.append(reinterpret_cast<const char*>(s.tags.data()), s.tags.size());
+    out.append(reinterpret_cast<const char*>(s.values.data()), s.values.size() * sizeof(OperandValue));
+    putBytes(out, m_checksum(out.data(), out.size()));
+
+    {
+        std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+            throw FailedToOpenFile(tmp);
+        file.write(out.data(), static_cast<std::streamsize>(out.size()));
+        if (!file.flush())
+            throw InvalidValue("Cannot write checkpoint " + tmp);
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0)
+        throw InvalidValue("Cannot rename checkpoint " + tmp + " to " + path);
+}
+
+Snapshot Checkpoint::load(const std::string& path)
+{
+    constexpr size_t kLoop = 3 * sizeof(uint64_t);
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+        throw FailedToOpenFile(path);
+    const std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    if (data.size() < sizeof(m_magic) + sizeof(uint64_t) || std::memcmp(data.data(), m_magic, sizeof(m_magic)) != 0)
+        m_corrupt(path);
+    const size_t payload = data.size() - sizeof(uint64_t);
+    ByteReader sum(data.data() + payload, sizeof(uint64_t));
+    if (sum.get<uint64_t>() != m_checksum(data.data(), payload))
+        m_corrupt(path);
+
+    ByteReader in(data.data() + sizeof(m_magic), payload - sizeof(m_magic));
+    if (in.get<uint32_t>() != kVersion)
+        m_corrupt(path);
+    Snapshot s;
+    s.inputSize = in.get<uint64_t>();
+    s.inputEnd = in.get<uint64_t>();
+    s.inputHash = in.get<uint64_t>();
+    s.windowOffset = in.get<uint64_t>();
+    s.windowLine = in.get<uint64_t>();
+    s.lastLine = in.get<uint64_t>();
+    s.base = in.get<uint64_t>();
+    s.pc = in.get<uint64_t>();
+    const uint64_t loops = in.get<uint64_t>();
+    const uint64_t depth = in.get<uint64_t>();
+    if (!in.ok() || loops > in.remaining() / kLoop
+        || depth != (in.remaining() - loops * kLoop) / (1 + sizeof(OperandValue))
+        || loops * kLoop + depth * (1 + sizeof(OperandValue)) != in.remaining())
+        m_corrupt(path);
+
+    for (uint64_t i = 0; i < loops; ++i)
+    {
+        Runner::Loop loop;
+        loop.start = in.get<uint64_t>();
+        loop.end = in.get<uint64_t>();
+        loop.remaining = in.get<int64_t>();
+        s.loops.push_back(loop);
+    }
+    std::string_view tags = in.take(depth);
+    s.tags.assign(tags.begin(), tags.end());
+    std::string_view values = in.take(depth * sizeof(OperandValue));
+    s.values.resize(depth);
+    std::memcpy(s.values.data(), values.data(), values.size());
+    for (uint8_t tag : s.tags)
+        if (tag >= None)
+            m_corrupt(path);
+    if (s.windowLine == 0 || s.windowLine > s.lastLine + 1)
+        m_corrupt(path);
+    return s;
+}
+
+void Checkpoint::restore(const Snapshot& s, inputReader& input, Assembler& code, Runner& runner, vm& machine)
+{
+    input.seek(s.windowOffset, s.windowLine);
+    code.rebase(s.base);
+    for (uint64_t no = s.windowLine; no <= s.lastLine; ++no)
+    {
+        if (input.readProgram(1) == 0)
+            throw InvalidValue("Snapshot does not match the input: it ends before line " + std::to_string(no));
+        code.append(input.getLine());
+    }
+    if (s.pc < code.base() || s.pc > code.end())
+        throw InvalidValue("Snapshot does not match the input");
+    runner.restore(s.pc, s.loops);
+    for (size_t i = 0; i < s.tags.size(); ++i)
+        machine.stack().push(static_cast<eOperandType>(s.tags[i]), s.values[i]);
+}
+
+void Checkpoint::resume(const std::string& path, inputReader& input, Assembler& code, Runner& runner, vm& machine)
+{
+    const Snapshot s = load(path);
+
+    if (s.inputSize != _inputSize || m_inputHash(_inputPath, s.inputEnd) != s.inputHash)
+        throw InvalidValue("Checkpoint " + path + " was taken on a different input");
+    restore(s, input, code, runner, machine);
+    _inputHash = s.inputHash;
+}
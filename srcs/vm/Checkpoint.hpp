@@ -0,0 +1,92 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include "vm.hpp"
+#include "Assembler.hpp"
+#include "Runner.hpp"
+
+/* Everything needed to carry on a run from where it was.
+ * The Assembler's code is not stored: on resume the input lines from
+ * `windowLine` (the first one it still held) to `lastLine` are parsed
+ * again, which restores its labels and loops too, so they must still be
+ * the lines that ran: `inputHash` covers every byte before `inputEnd`.
+ * Values are stored in native byte order, so a snapshot is for the
+ * machine that wrote it.
+ */
+struct Snapshot
+{
+    uint64_t inputSize;         /* of the input file, to catch a changed one */
+    uint64_t inputEnd;          /* input offset after lastLine */
+    uint64_t inputHash;         /* FNV-1a of input bytes [0, inputEnd), lines ending in '\n' */
+    uint64_t windowOffset;
+    uint64_t windowLine;
+    uint64_t lastLine;          /* the last line appended */
+    uint64_t base;              /* Assembler::base() */
+    uint64_t pc;
+    std::vector<Runner::Loop> loops;
+    std::vector<uint8_t> tags;
+    std::vector<OperandValue> values;
+};
+
+/* Periodic snapshots of a running program, for --checkpoint-every and
+ * --resume. A forked child writes each snapshot from its copy-on-write
+ * image while the parent keeps running; if the previous one is still
+ * being written when the next is due, that one is skipped. Files are
+ * written to a temporary name and renamed, so a crash never leaves a
+ * torn snapshot behind.
+ */
+class Checkpoint
+{
+    private:
+        std::string _path;
+        std::string _inputPath;
+        size_t _every;
+        size_t _budget;
+        uint64_t _inputSize;
+        uint64_t _inputHash;    /* of the lines run() has seen */
+        pid_t _writer;
+
+        void m_take(const Runner& runner, const Assembler& code, const vm& machine, const Line& last);
+        bool m_reap(bool wait);
+
+        Checkpoint();
+        Checkpoint(const Checkpoint& other);
+        const Checkpoint& operator=(const Checkpoint& other);
+
+    public:
+        /* Snapshots of `inputPath`, of `inputSize` bytes, go to
+         * `inputPath`.ckpt; `every` 0 disables them. */
+        Checkpoint(const std::string& inputPath, size_t every, uint64_t inputSize);
+        /* Waits for a snapshot still being written. */
+        ~Checkpoint();
+
+        /* runner.run(), stopping every `every` instructions to snapshot the
+         * state after `last`, the line appended most recently. Must be
+         * called once for every line appended. */
+        Error run(Runner& runner, const Assembler& code, const vm& machine, const Line& last);
+
+        /* The state after `last`, the line appended most recently, of an
+         * input file of `inputSize` bytes whose lines up to `last` hash to
+         * `inputHash`. */
+        static Snapshot capture(const Runner& runner, const Assembler& code, const vm& machine, const Line& last,
+                                uint64_t inputSize, uint64_t inputHash);
+        /* FNV-1a of `len` more bytes, from `h` (kFnvBasis to start). */
+        static constexpr uint64_t kFnvBasis = 0xcbf29ce484222325ULL;
+        static uint64_t hash(uint64_t h, const void* data, size_t len);
+        /* Puts input, code, runner and the vm's stack back as they were;
+         * `code` and the stack must still be empty. Throws InvalidValue if
+         * the input is shorter than the snapshot expects. */
+        static void restore(const Snapshot& snapshot, inputReader& input, Assembler& code, Runner& runner,
+                            vm& machine);
+
+        /* Throws FailedToOpenFile, or InvalidValue for a corrupt file. */
+        static void save(const std::string& path, const Snapshot& snapshot);
+        static Snapshot load(const std::string& path);
+        /* load() and restore(), after checking that the input still has
+         * the size and, up to the snapshot's last line, the bytes it was
+         * taken on. Throws InvalidValue if not. Later snapshots carry on
+         * from the restored state. */
+        void resume(const std::string& path, inputReader& input, Assembler& code, Runner& runner, vm& machine);
+};
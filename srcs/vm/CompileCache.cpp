@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+#include <vector>
+#include "CompileCache.hpp"
+#include "MappedFile.hpp"
+#include "../utils/ByteIO.hpp"
+
+/* Layout: "AVMC", u32 format version, u32 length + ABI key, the 16-byte
+ * source hash, u64 length + Program::save() payload, then the low half of
+ * the payload's murmur3 hash. Bump kFormatVersion with the layout. */
+static const char m_magic[4] = { 'A', 'V', 'M', 'C' };
+static constexpr uint32_t kFormatVersion = 1;
+
+/* Anything that changes what a saved Program means: the layouts it was
+ * saved with and the executable that saved it, since any rebuild may
+ * parse differently. */
+static const std::string& m_abiKey()
+{
+    static const std::string key = [] {
+        std::ostringstream k;
+        k << sizeof(Instruction) << '/' << sizeof(OperandValue) << '/' << static_cast<int>(OpCode::None) << '/'
+          << __VERSION__;
+        MappedFile self;
+        if (!self.map("/proc/self/exe", SIZE_MAX).failed())
+        {
+            Hash128 h = murmur3_128(self.data(), self.size());
+            k << '/' << std::hex << h.hi << h.lo;
+        }
+        return k.str();
+    }();
+    return key;
+}
+
+CompileCache::CompileCache(const std::string& dir, uint64_t maxBytes) : _dir(dir), _maxBytes(maxBytes)
+{
+}
+
+CompileCache::~CompileCache()
+{
+}
+
+Hash128 CompileCache::key(const unsigned char* source, size_t size)
+{
+    return murmur3_128(source, size);
+}
+
+std::string CompileCache::m_path(const Hash128& key) const
+{
+    char name[40];
+    std::snprintf(name, sizeof(name), "%016llx%016llx.avmc", static_cast<unsigned long long>(key.hi),
+                  static_cast<unsigned long long>(key.lo));
+    return _dir + "/" + name;
+}
+
+bool CompileCache::load(const Hash128& key, Program& program) const
+{
+    const std::string path = m_path(key);
+    MappedFile file;
+
+    if (file.map(path, SIZE_MAX).failed())
+        return false;
+    ByteReader in(reinterpret_cast<const char*>(file.data()), file.size());
+    if (in.take(sizeof(m_magic)) != std::string_view(m_magic, sizeof(m_magic)) || in.get<uint32_t>() != kFormatVersion)
+        return false;
+    const std::string_view abi = in.take(in.get<uint32_t>());
+    const uint64_t lo = in.get<uint64_t>();
+    const uint64_t hi = in.get<uint64_t>();
+    const std::string_view payload = in.take(in.get<uint64_t>());
+    const uint64_t sum = in.get<uint64_t>();
+    if (!in.ok() || in.remaining() != 0 || abi != m_abiKey() || lo != key.lo || hi != key.hi
+        || murmur3_128(payload.data(), payload.size()).lo != sum)
+        return false;
+
+    ByteReader body(payload.data(), payload.size());
+    if (!program.load(body))
+        return false;
+    std::error_code ec;
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+    return true;
+}
+
+void CompileCache::store(const Hash128& key, const Program& program) const
+{
+    std::string payload;
+    std::string out;
+    std::error_code ec;
+
+    if (!program.save(payload))
+        return;
+    out.append(m_magic, sizeof(m_magic));
+    putBytes(out, kFormatVersion);
+    putBytes(out, static_cast<uint32_t>(m_abiKey().size()));
+    out += m_abiKey();
+    putBytes(out, key.lo);
+    putBytes(out, key.hi);
+    putBytes(out, static_cast<uint64_t>(payload.size()));
+    out += payload;
+    putBytes(out, murmur3_128(payload.data(), payload.size()).lo);
+
+    std::filesystem::create_directories(_dir, ec);
+    const std::string path = m_path(key);
+    const std::string tmp = path + ".tmp" + std::to_string(getpid());
+    {
+        std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+            return;
+        file.write(out.data(), static_cast<std::streamsize>(out.size()));
+        if (!file.flush())
+        {
+            file.close();
+            std::filesystem::remove(tmp, ec);
+            return;
+        }
+    }
+    std::filesystem::rename(tmp, path, ec);
+    if (ec)
+        std::filesystem::remove(tmp, ec);
+    m_evict();
+}
+
+void CompileCache::m_evict() const
+{
+    namespace fs = std::filesystem;
+    struct Entry
+    {
+        fs::path path;
+        fs::file_time_type used;
+        uintmax_t size;
+    };
+    std::vector<Entry> entries;
+    uintmax_t total = 0;
+    std::error_code ec;
+
+    for (fs::directory_iterator it(_dir, ec), end; !ec && it != end; it.increment(ec))
+    {
+        if (it->path().extension() != ".avmc" || !it->is_regular_file(ec))
+            continue;
+        Entry e{it->path(), it->last_write_time(ec), it->file_size(ec)};
+        if (ec)
+            continue;
+        total += e.size;
+        entries.push_back(std::move(e));
+    }
+    if (total <= _maxBytes)
+        return;
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.used < b.used; });
+    for (const Entry& e : entries)
+    {
+        if (total <= _maxBytes)
+            break;
+        if (fs::remove(e.path, ec))
+            total -= e.size;
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "Program.hpp"
+#include "../utils/Hash.hpp"
+
+/* On-disk cache of compiled Programs, addressed by a 128-bit hash of the
+ * source text, so re-running an unchanged program skips lexing and
+ * parsing. Entries are written to a temporary file and renamed into
+ * place, so concurrent runs never see a partial one. Each entry records
+ * the format version and an ABI key (instruction layout and a hash of
+ * the executable); an entry from any other build is ignored and
+ * overwritten.
+ * A hit refreshes the entry's mtime; after a store, the entries used
+ * least recently are deleted until the directory fits in `maxBytes`.
+ *
+ * The cache is only an optimization: I/O errors make lookups miss and
+ * stores do nothing.
+ */
+class CompileCache
+{
+    private:
+        std::string _dir;
+        uint64_t _maxBytes;
+
+        std::string m_path(const Hash128& key) const;
+        void m_evict() const;
+
+        CompileCache();
+        CompileCache(const CompileCache& other);
+        const CompileCache& operator=(const CompileCache& other);
+
+    public:
+        static constexpr uint64_t kDefaultMaxBytes = uint64_t(256) << 20;
+
+        CompileCache(const std::string& dir, uint64_t maxBytes);
+        ~CompileCache();
+
+        static Hash128 key(const unsigned char* source, size_t size);
+        /* True if `program` was filled from a valid entry for `key`; on false
+         * it may be partly filled and should be discarded. */
+        bool load(const Hash128& key, Program& program) const;
+        void store(const Hash128& key, const Program& program) const;
+};
@@ -0,0 +1,102 @@
+#include "ConstantPool.hpp"
+#include "../operand/OperandFactory.hpp"
+
+uint32_t ConstantPool::m_find(eOperandType type, char kind, std::string_view literal)
+{
+    _key.clear();
+    _key += static_cast<char>('0' + type);
+    _key += kind;
+    _key.append(literal);
+
+    auto it = _index.find(_key);
+    if (it != _index.end())
+        return it->second;
+
+    uint32_t index = static_cast<uint32_t>(_constants.size());
+    _constants.push_back(Constant{type, OperandValue{}, std::string(literal), Error()});
+    _index.emplace(_key, index);
+    return index;
+}
+
+uint32_t ConstantPool::intern(eOperandType type, std::string_view literal)
+{
+    size_t before = _constants.size();
+    uint32_t index = m_find(type, 'v', literal);
+
+    if (_constants.size() != before)
+    {
+        Constant& c = _constants[index];
+        Expected<OperandValue> value = OperandFactory::tryCreateValue(type, c.literal);
+        if (value)
+            c.value = *value;
+        else
+            c.error = value.error();
+    }
+    return index;
+}
+
+uint32_t ConstantPool::internText(eOperandType type, std::string_view text)
+{
+    return m_find(type, 't', text);
+}
+
+uint32_t ConstantPool::addError(const Error& error)
+{
+    _constants.push_back(Constant{None, OperandValue{}, std::string(), error});
+    return static_cast<uint32_t>(_constants.size() - 1);
+}
+
+void ConstantPool::clear()
+{
+    _constants.clear();
+    _index.clear();
+}
+
+bool ConstantPool::save(std::string& out) const
+{
+    std::vector<const std::string*> keys(_constants.size(), nullptr);
+
+    for (const auto& [key, index] : _index)
+        keys[index] = &key;
+    putBytes(out, static_cast<uint32_t>(_constants.size()));
+    for (size_t i = 0; i < _constants.size(); ++i)
+    {
+        if (!keys[i])
+            return false;
+        putBytes(out, static_cast<uint32_t>(keys[i]->size()));
+        out += *keys[i];
+        putBytes(out, static_cast<uint8_t>(_constants[i].error.failed()));
+        putBytes(out, _constants[i].value);
+    }
+    return true;
+}
+
+bool ConstantPool::load(ByteReader& in)
+{
+    const uint32_t count = in.get<uint32_t>();
+
+    clear();
+    if (count > in.remaining())
+        return false;
+    _constants.reserve(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        std::string_view key = in.take(in.get<uint32_t>());
+        const bool failed = in.get<uint8_t>() != 0;
+        const OperandValue value = in.get<OperandValue>();
+        if (!in.ok() || key.size() < 2 || key[0] < '0' || key[0] > '0' + None || (key[1] != 'v' && key[1] != 't')
+            || (key[1] == 'v' && key[0] == '0' + None))
+            return false;
+
+        _constants.push_back(Constant{static_cast<eOperandType>(key[0] - '0'), value, std::string(key.substr(2)), Error()});
+        Constant& c = _constants.back();
+        if (failed)
+        {
+            Expected<OperandValue> converted = OperandFactory::tryCreateValue(c.type, c.literal);
+            if (key[1] != 'v' || converted)
+                return false;
+            c.error = converted.error();
+        }
+    }
+    return in.ok();
+}
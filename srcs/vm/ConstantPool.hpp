@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "../operand/IOperand.hpp"
+#include "../operand/OperandValue.hpp"
+#include "../exception/Error.hpp"
+#include "../utils/ByteIO.hpp"
+
+/* Literals of push/assert/reduction/load instructions, interned at parse
+ * time. Each distinct (type, literal) is validated and converted once;
+ * an Instruction refers to it by index. A literal that fails to convert
+ * (e.g. int8(300)) keeps its Error, which the vm reports when an
+ * instruction using it executes, as if it had just been parsed.
+ */
+struct Constant
+{
+    eOperandType type;
+    OperandValue value;
+    std::string literal;    /* kept for messages and load paths */
+    Error error;
+};
+
+class ConstantPool
+{
+    private:
+        std::vector<Constant> _constants;
+        std::unordered_map<std::string, uint32_t> _index;
+        std::string _key;
+
+        uint32_t m_find(eOperandType type, char kind, std::string_view literal);
+
+    public:
+        static constexpr uint32_t kNone = UINT32_MAX;
+
+        /* Index of `literal` converted to `type`. */
+        uint32_t intern(eOperandType type, std::string_view literal);
+        /* Index of `text` kept verbatim (a load path or label name). */
+        uint32_t internText(eOperandType type, std::string_view text);
+        /* Index of a new constant holding only `error` (a Fault's). */
+        uint32_t addError(const Error& error);
+
+        const Constant& operator[](uint32_t index) const { return _constants[index]; }
+        size_t size() const { return _constants.size(); }
+        /* Invalidates every index handed out so far. */
+        void clear();
+
+        /* Appends the pool to `out` for the compile cache; false if it holds
+         * a Fault's error, which cannot be saved. */
+        bool save(std::string& out) const;
+        /* Replaces the pool with a saved one, keeping every index; converted
+         * values are taken as saved, failed ones are converted again to
+         * rebuild their Error. The loaded pool is for running only: it is
+         * not indexed, so it neither shares new literals nor saves again.
+         * False if `in` is malformed. */
+        bool load(ByteReader& in);
+};
@@ -0,0 +1,88 @@
+#include "LazyStack.hpp"
+
+LazyStack::LazyStack()
+{
+}
+
+LazyStack::~LazyStack()
+{
+}
+
+uint32_t LazyStack::m_newNode()
+{
+    if (!_free.empty())
+    {
+        const uint32_t node = _free.back();
+        _free.pop_back();
+        return node;
+    }
+    _nodes.emplace_back();
+    return static_cast<uint32_t>(_nodes.size() - 1);
+}
+
+/* Drops one reference; a node nothing refers to any more gives up its
+ * operands in turn. */
+void LazyStack::m_release(uint32_t node)
+{
+    _work.push_back(node);
+    while (!_work.empty())
+    {
+        const uint32_t x = _work.back();
+        Node& n = _nodes[x];
+        _work.pop_back();
+        if (--n.refs > 0)
+            continue;
+        if (n.op != 0)
+        {
+            _work.push_back(n.lhs);
+            _work.push_back(n.rhs);
+        }
+        _free.push_back(x);
+    }
+}
+
+void LazyStack::push(eOperandType type, OperandValue value)
+{
+    const uint32_t node = m_newNode();
+    _nodes[node] = Node{value, 0, 0, 1, 0, static_cast<uint8_t>(type), true};
+    _slots.push_back(node);
+}
+
+void LazyStack::pop()
+{
+    m_release(_slots.back());
+    _slots.pop_back();
+}
+
+/* The operands' slot references move to the new node. */
+void LazyStack::apply(uint8_t op, eOperandType type)
+{
+    const uint32_t node = m_newNode();
+    const uint32_t rhs = _slots.back();
+    _slots.pop_back();
+    _nodes[node] = Node{OperandValue{}, _slots.back(), rhs, 1, op, static_cast<uint8_t>(type), false};
+    _slots.back() = node;
+}
+
+void LazyStack::copyToTop(size_t fromTop)
+{
+    const uint32_t node = _slots[_slots.size() - 1 - fromTop];
+    ++_nodes[node].refs;
+    _slots.push_back(node);
+}
+
+void LazyStack::swap(size_t a, size_t b)
+{
+    std::swap(_slots[_slots.size() - 1 - a], _slots[_slots.size() - 1 - b]);
+}
+
+bool LazyStack::known(size_t fromTop, eOperandType& type, OperandValue& value) const
+{
+    const Node& n = _nodes[_slots[_slots.size() - 1 - fromTop]];
+
+    if (!n.done)
+        return false;
+    type = static_cast<eOperandType>(n.type);
+    value = n.value;
+    return true;
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "OperandStack.hpp"
+
+/* The top of a lazy vm's stack: slots that refer to nodes of a dataflow
+ * graph instead of holding values. A push adds a leaf with its value; an
+ * arithmetic instruction that cannot fail adds a node over the two slots
+ * it consumes, with the type its result will have. Nodes are reference
+ * counted, so popping a slot frees
+ * every node only it was keeping alive without computing any of them.
+ *
+ * flush() computes what the slots still need, shared nodes once, and
+ * pushes the values onto the real stack below, leaving the graph empty.
+ * The graph holds at most kMaxNodes nodes; full() tells the vm to flush.
+ */
+class LazyStack
+{
+    public:
+        static constexpr size_t kMaxNodes = size_t(1) << 20;
+
+    private:
+        struct Node
+        {
+            OperandValue value;     /* once `done` */
+            uint32_t lhs;
+            uint32_t rhs;
+            uint32_t refs;
+            uint8_t op;             /* OpCode of an arithmetic node, 0 for a leaf */
+            uint8_t type;           /* eOperandType */
+            bool done;
+        };
+
+        std::vector<Node> _nodes;
+        std::vector<uint32_t> _free;
+        std::vector<uint32_t> _slots;   /* bottom to top */
+        std::vector<uint32_t> _work;
+
+        uint32_t m_newNode();
+        void m_release(uint32_t node);
+
+        LazyStack(const LazyStack& other);
+        const LazyStack& operator=(const LazyStack& other);
+
+    public:
+        LazyStack();
+        ~LazyStack();
+
+        size_t size() const { return _slots.size(); }
+        bool empty() const { return _slots.empty(); }
+        bool full() const { return _free.empty() && _nodes.size() >= kMaxNodes; }
+
+        void push(eOperandType type, OperandValue value);
+        void pop();
+        /* Replaces the top two slots (lhs below rhs) with a node for `op`
+         * whose result is of `type`. */
+        void apply(uint8_t op, eOperandType type);
+        void copyToTop(size_t fromTop);
+        void swap(size_t a, size_t b);
+
+        eOperandType typeAt(size_t fromTop) const
+        {
+            return static_cast<eOperandType>(_nodes[_slots[_slots.size() - 1 - fromTop]].type);
+        }
+        /* The value of the slot `fromTop` below the top, if already known. */
+        bool known(size_t fromTop, eOperandType& type, OperandValue& value) const;
+
+        /* compute(op, lhsType, lhs, rhsType, rhs, value) fills in the
+         * result of one node; it must not fail. */
+        template <typename Fn>
+        void flush(OperandStack& stack, Fn compute)
+        {
+            for (uint32_t slot : _slots)
+            {
+                _work.push_back(slot);
+                while (!_work.empty())
+                {
+                    Node& n = _nodes[_work.back()];
+                    if (n.done)
+                    {
+                        _work.pop_back();
+                        continue;
+                    }
+                    const Node& l = _nodes[n.lhs];
+                    const Node& r = _nodes[n.rhs];
+                    if (!l.done)
+                        _work.push_back(n.lhs);
+                    else if (!r.done)
+                        _work.push_back(n.rhs);
+                    else
+                    {
+                        compute(n.op, static_cast<eOperandType>(l.type), l.value, static_cast<eOperandType>(r.type),
+                                r.value, n.value);
+                        n.done = true;
+                        _work.pop_back();
+                    }
+                }
+                const Node& n = _nodes[slot];
+                stack.push(static_cast<eOperandType>(n.type), n.value);
+            }
+            _slots.clear();
+            _nodes.clear();
+            _free.clear();
+        }
+};
@@ -0,0 +1,61 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "MappedFile.hpp"
+
+static const ErrorDesc m_openFailed = { ErrorKind::FailedToOpenFile, "%s" };
+static const ErrorDesc m_tooLarge = { ErrorKind::InvalidValue, "File exceeds load size limit (%s" };
+
+MappedFile::MappedFile() : _data(nullptr), _size(0)
+{
+}
+
+MappedFile::MappedFile(const std::string& path, size_t maxBytes) : _data(nullptr), _size(0)
+{
+    Error err = map(path, maxBytes);
+    if (err.failed())
+        err.raise();
+}
+
+Error MappedFile::map(const std::string& path, size_t maxBytes)
+{
+    struct stat st;
+    int fd = ::open(path.c_str(), O_RDONLY);
+
+    if (fd < 0)
+        return Error(m_openFailed, 0, 0, path);
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        ::close(fd);
+        return Error(m_openFailed, 0, 0, path);
+    }
+    if (static_cast<size_t>(st.st_size) > maxBytes)
+    {
+        ::close(fd);
+        return Error(m_tooLarge, 0, 0, std::to_string(st.st_size) + " > "
+                     + std::to_string(maxBytes) + " bytes): " + path);
+    }
+
+    _size = static_cast<size_t>(st.st_size);
+    if (_size > 0)
+    {
+        void* p = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED)
+        {
+            ::close(fd);
+            _size = 0;
+            return Error(m_openFailed, 0, 0, path);
+        }
+        madvise(p, _size, MADV_SEQUENTIAL);
+        _data = static_cast<const unsigned char*>(p);
+    }
+    ::close(fd);
+    return Error();
+}
+
+MappedFile::~MappedFile()
+{
+    if (_data)
+        munmap(const_cast<unsigned char*>(_data), _size);
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include "../exception/Error.hpp"
+
+/* Read-only private memory mapping of a whole file (RAII). */
+class MappedFile
+{
+    private:
+        const unsigned char* _data;
+        size_t _size;
+
+        MappedFile(const MappedFile& other);
+        const MappedFile& operator=(const MappedFile& other);
+
+    public:
+        /* An empty mapping, for map(). */
+        MappedFile();
+        /* Throws FailedToOpenFile; refuses files larger than `maxBytes`
+         * with InvalidValue before mapping anything. */
+        MappedFile(const std::string& path, size_t maxBytes);
+        /* Same as the constructor, reporting failure as an Error. */
+        Error map(const std::string& path, size_t maxBytes);
+        ~MappedFile();
+
+        const unsigned char* data() const { return _data; }
+        size_t size() const { return _size; }
+};
@@ -0,0 +1,249 @@
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <new>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "OperandStack.hpp"
+#include "../stats/MemStats.hpp"
+#include "../utils/Parallel.hpp"
+
+/* Chunks are aligned to the huge page size so the value lane can be
+ * backed by one. */
+static constexpr size_t kHugePageBytes = size_t(2) << 20;
+
+/* One free chunk per thread outlives the stack that used it, so code that
+ * makes a vm per task (--rows) does not map and fault in a chunk each
+ * time. */
+struct ChunkCache
+{
+    void* chunk = nullptr;
+    size_t bytes = 0;
+
+    ~ChunkCache()
+    {
+        if (!chunk)
+            return;
+        if (MemStats::enabled())
+            MemStats::onFree(MemSubsystem::Stack, bytes);
+        ::operator delete(chunk, std::align_val_t(kHugePageBytes));
+    }
+};
+static thread_local ChunkCache m_chunkCache;
+
+OperandStack::OperandStack()
+    : _top(nullptr), _spare(nullptr), _used(kChunkSize), _size(0), _memoryChunks(SIZE_MAX), _spilled(0), _spillFd(-1)
+{
+}
+
+OperandStack::~OperandStack()
+{
+    for (size_t i = 0; i < _chunks.size(); ++i)
+    {
+        if (i < _spilled)
+            munmap(_chunks[i], sizeof(Chunk));
+        else
+            m_freeChunk(_chunks[i]);
+    }
+    m_freeChunk(_spare);
+    if (_spillFd >= 0)
+        close(_spillFd);
+}
+
+void OperandStack::setMemoryBudget(size_t bytes)
+{
+    _memoryChunks = std::max<size_t>(2, bytes / sizeof(Chunk));
+}
+
+static std::string m_spillDir()
+{
+    const char* dir = std::getenv("TMPDIR");
+    return dir && *dir ? dir : "/tmp";
+}
+
+/* An unlinked file, so it goes away with the process however it ends. */
+static int m_openSpillFile()
+{
+    std::string path = m_spillDir() + "/avm-stack-XXXXXX";
+    int fd = mkstemp(path.data());
+
+    if (fd >= 0)
+        unlink(path.c_str());
+    return fd;
+}
+
+/* Giving up on spilling lifts the budget, which the user asked for to
+ * stay clear of the OOM killer, so it must not go unnoticed. */
+void OperandStack::m_spillFailed(const char* what)
+{
+    const int err = errno;
+
+    std::cerr << "Warning: cannot " << what << " the stack spill file in " << m_spillDir() << ": "
+              << std::strerror(err) << "; --stack-mem-budget no longer applies\n";
+    _memoryChunks = SIZE_MAX;
+}
+
+/* Moves the oldest chunk in memory to the spill file. Writing it with
+ * pwrite and starting writeback at once keeps the push that triggers it
+ * from faulting in the mapping page by page. */
+void OperandStack::m_spill()
+{
+    const size_t bytes = sizeof(Chunk);
+    const off_t at = static_cast<off_t>(_spilled * bytes);
+    Chunk* chunk = _chunks[_spilled];
+
+    if (_spillFd < 0)
+        _spillFd = m_openSpillFile();
+    if (_spillFd < 0)
+    {
+        m_spillFailed("create");
+        return;
+    }
+    const ssize_t written = pwrite(_spillFd, chunk, bytes, at);
+    if (written != static_cast<ssize_t>(bytes))
+    {
+        if (written >= 0)
+            errno = ENOSPC;
+        m_spillFailed("write");
+        return;
+    }
+    void* mapped = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, _spillFd, at);
+    if (mapped == MAP_FAILED)
+    {
+        m_spillFailed("map");
+        return;
+    }
+#ifdef SYNC_FILE_RANGE_WRITE
+    sync_file_range(_spillFd, at, static_cast<off_t>(bytes), SYNC_FILE_RANGE_WRITE);
+#endif
+    m_freeChunk(chunk);
+    _chunks[_spilled++] = static_cast<Chunk*>(mapped);
+}
+
+/* The top chunk is spilled: read it back into memory. */
+void OperandStack::m_unspill()
+{
+    Chunk* mapped = _chunks[--_spilled];
+    Chunk* chunk = _spare ? _spare : m_allocChunk(false);
+
+    _spare = nullptr;
+    std::memcpy(chunk, mapped, sizeof(Chunk));
+    munmap(mapped, sizeof(Chunk));
+    if (ftruncate(_spillFd, static_cast<off_t>(_spilled * sizeof(Chunk))) != 0)
+    {
+        /* Only disk space is lost; the next spill overwrites it. */
+    }
+    _chunks[_spilled] = chunk;
+    _top = chunk;
+}
+
+OperandStack::Chunk* OperandStack::m_allocChunk(bool huge)
+{
+    Chunk* chunk = static_cast<Chunk*>(m_chunkCache.chunk);
+
+    m_chunkCache.chunk = nullptr;
+    if (!chunk)
+    {
+        chunk = static_cast<Chunk*>(::operator new(sizeof(Chunk), std::align_val_t(kHugePageBytes)));
+        if (MemStats::enabled())
+            MemStats::onAlloc(MemSubsystem::Stack, sizeof(Chunk));
+    }
+#ifdef MADV_HUGEPAGE
+    if (huge)
+        madvise(chunk->values, sizeof(chunk->values), MADV_HUGEPAGE);
+#else
+    (void)huge;
+#endif
+    return chunk;
+}
+
+void OperandStack::m_freeChunk(Chunk* chunk)
+{
+    if (!chunk)
+        return;
+    if (!m_chunkCache.chunk)
+    {
+        m_chunkCache.chunk = chunk;
+        m_chunkCache.bytes = sizeof(Chunk);
+        return;
+    }
+    if (MemStats::enabled())
+        MemStats::onFree(MemSubsystem::Stack, sizeof(Chunk));
+    ::operator delete(chunk, std::align_val_t(kHugePageBytes));
+}
+
+/* The top chunk is full (or there is none): start the next one. */
+void OperandStack::m_grow()
+{
+    Chunk* chunk = _spare ? _spare : m_allocChunk(!_chunks.empty());
+    _spare = nullptr;
+    _chunks.push_back(chunk);
+    _top = chunk;
+    _used = 0;
+    while (_chunks.size() - _spilled > _memoryChunks)
+        m_spill();
+}
+
+/* Popping from an empty top chunk: keep it as the spare, dropping the
+ * older one, and go on in the full chunk below. */
+void OperandStack::m_shrink()
+{
+    m_freeChunk(_spare);
+    _spare = _chunks.back();
+    _chunks.pop_back();
+    _top = _chunks.empty() ? nullptr : _chunks.back();
+    _used = kChunkSize;
+    if (_spilled == _chunks.size() && _spilled > 0)
+        m_unspill();
+}
+
+/* Appends chunk `c`'s values, top first, one per line. A spilled chunk
+ * is read ahead as a whole and dropped once formatted, so dumping stays
+ * within the memory budget. */
+void OperandStack::m_formatChunk(size_t c, std::string& out) const
+{
+    static constexpr size_t kBufSize = 1 << 16;
+    const Chunk& chunk = *_chunks[c];
+    char buf[kBufSize];
+    size_t used = 0;
+
+    if (c < _spilled)
+        madvise(_chunks[c], sizeof(Chunk), MADV_WILLNEED);
+    for (size_t i = c + 1 == _chunks.size() ? _used : kChunkSize; i-- > 0;)
+    {
+        if (kBufSize - used < kMaxValueChars + 1)
+        {
+            out.append(buf, used);
+            used = 0;
+        }
+        used += formatValue(buf + used, static_cast<eOperandType>(chunk.tags[i]), chunk.values[i]);
+        buf[used++] = '\n';
+    }
+    out.append(buf, used);
+    if (c < _spilled)
+        madvise(_chunks[c], sizeof(Chunk), MADV_DONTNEED);
+}
+
+/* Large stacks are formatted a window of chunks at a time, one chunk per
+ * task on one set of workers, and each window is written in order. */
+void OperandStack::dump(std::ostream& os, unsigned jobs) const
+{
+    const size_t chunks = _chunks.size();
+    WorkerPool pool(chunks < kParallelDumpChunks ? 1 : jobs);
+    const size_t window = std::min<size_t>(chunks, size_t(pool.jobs()) * 2);
+    std::vector<std::string> texts(window);
+
+    for (size_t done = 0; done < chunks; done += window)
+    {
+        const size_t n = std::min(window, chunks - done);
+        pool.run(n, [&](size_t k) {
+            texts[k].clear();
+            m_formatChunk(chunks - 1 - done - k, texts[k]);
+        });
+        for (size_t k = 0; k < n; ++k)
+            os.write(texts[k].data(), static_cast<std::streamsize>(texts[k].size()));
+    }
+}
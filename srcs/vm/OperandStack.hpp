@@ -0,0 +1,172 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../operand/OperandValue.hpp"
+
+/* Structure-of-arrays operand stack.
+ * One byte lane of eOperandType tags and a parallel lane of 8-byte native
+ * value slots; index 0 is the bottom. Scans (dump, bulk operations) walk
+ * both lanes sequentially instead of chasing heap IOperand pointers.
+ *
+ * The lanes are split into fixed-size chunks, so growing never copies
+ * what is already there: the worst-case push allocates one chunk, and the
+ * memory peak is the stack plus at most two chunks. An emptied chunk
+ * stays on top until a pop needs the one below, and is then kept as a
+ * spare, so pushes and pops around a chunk boundary do not allocate.
+ * Chunks beyond the first ask for transparent huge pages, which small
+ * stacks never touch.
+ *
+ * With a memory budget, the oldest chunks beyond it are spilled: copied
+ * to an unlinked temporary file and mapped back in, so the kernel can
+ * write them out and drop them instead of running out of memory. The top
+ * chunks stay in memory; a spilled chunk is read back only when popping
+ * reaches it.
+ */
+class OperandStack
+{
+    public:
+        static constexpr size_t kChunkShift = 18;
+        static constexpr size_t kChunkSize = size_t(1) << kChunkShift;
+        /* Dumps of at least this many chunks are formatted in parallel. */
+        static constexpr size_t kParallelDumpChunks = 4;
+
+    private:
+        struct Chunk
+        {
+            OperandValue values[kChunkSize];
+            uint8_t tags[kChunkSize];
+        };
+
+        std::vector<Chunk*> _chunks;    /* full ones, then the top one */
+        Chunk* _top;                    /* _chunks.back(), or null */
+        Chunk* _spare;
+        size_t _used;                   /* slots used in the top chunk (may be 0); kChunkSize with none */
+        size_t _size;
+        size_t _memoryChunks;           /* most chunks kept in memory */
+        size_t _spilled;                /* bottom chunks mapped from the spill file */
+        int _spillFd;
+
+        void m_grow();
+        void m_shrink();
+        void m_spill();
+        void m_spillFailed(const char* what);
+        void m_unspill();
+        void m_formatChunk(size_t c, std::string& out) const;
+        static Chunk* m_allocChunk(bool huge);
+        static void m_freeChunk(Chunk* chunk);
+
+        Chunk& m_chunkOf(size_t index) const { return *_chunks[index >> kChunkShift]; }
+        static size_t m_slotOf(size_t index) { return index & (kChunkSize - 1); }
+
+        OperandStack(const OperandStack& other);
+        const OperandStack& operator=(const OperandStack& other);
+
+    public:
+        OperandStack();
+        ~OperandStack();
+
+        /* Keeps about `bytes` of the top of the stack in memory (two
+         * chunks at least) and spills the rest to a file in $TMPDIR. If
+         * the file cannot be written, a warning goes to stderr and
+         * everything stays in memory from then on. */
+        void setMemoryBudget(size_t bytes);
+
+        size_t size() const { return _size; }
+        bool empty() const { return _size == 0; }
+
+        void push(eOperandType type, OperandValue value)
+        {
+            if (_used == kChunkSize)
+                m_grow();
+            _top->tags[_used] = static_cast<uint8_t>(type);
+            _top->values[_used] = value;
+            ++_used;
+            ++_size;
+        }
+
+        void pop()
+        {
+            if (_used == 0)
+                m_shrink();
+            --_used;
+            --_size;
+        }
+
+        /* Pushes `n` values of one type; fill(dst, offset, len) writes the
+         * value slots of each contiguous run, offset counting from the
+         * first new value. */
+        template <typename Fn>
+        void append(eOperandType type, size_t n, Fn fill)
+        {
+            for (size_t offset = 0; offset < n;)
+            {
+                if (_used == kChunkSize)
+                    m_grow();
+                Chunk& top = *_top;
+                const size_t len = std::min(n - offset, kChunkSize - _used);
+                std::memset(top.tags + _used, static_cast<uint8_t>(type), len);
+                fill(top.values + _used, offset, len);
+                _used += len;
+                _size += len;
+                offset += len;
+            }
+        }
+
+        /* Pushes a copy of the value `fromTop` slots below the top. */
+        void copyToTop(size_t fromTop)
+        {
+            push(typeAt(fromTop), valueAt(fromTop));
+        }
+
+        /* Exchanges two slots, counted from the top. */
+        void swap(size_t a, size_t b)
+        {
+            const size_t ia = _size - 1 - a;
+            const size_t ib = _size - 1 - b;
+            Chunk& ca = m_chunkOf(ia);
+            Chunk& cb = m_chunkOf(ib);
+            std::swap(ca.tags[m_slotOf(ia)], cb.tags[m_slotOf(ib)]);
+            std::swap(ca.values[m_slotOf(ia)], cb.values[m_slotOf(ib)]);
+        }
+
+        /* 0 is the top of the stack. */
+        eOperandType typeAt(size_t fromTop) const
+        {
+            if (fromTop < _used)
+                return static_cast<eOperandType>(_top->tags[_used - 1 - fromTop]);
+            const size_t i = _size - 1 - fromTop;
+            return static_cast<eOperandType>(m_chunkOf(i).tags[m_slotOf(i)]);
+        }
+        OperandValue valueAt(size_t fromTop) const
+        {
+            if (fromTop < _used)
+                return _top->values[_used - 1 - fromTop];
+            const size_t i = _size - 1 - fromTop;
+            return m_chunkOf(i).values[m_slotOf(i)];
+        }
+
+        /* Calls fn(tags, values, count) over contiguous runs covering
+         * [first, last) in bottom-based indices, bottom to top. */
+        template <typename Fn>
+        void forRange(size_t first, size_t last, Fn fn) const
+        {
+            while (first < last)
+            {
+                const Chunk& chunk = m_chunkOf(first);
+                const size_t slot = m_slotOf(first);
+                const size_t len = std::min(last - first, kChunkSize - slot);
+                fn(chunk.tags + slot, chunk.values + slot, len);
+                first += len;
+            }
+        }
+
+        /* Writes every value, top first, one per line; large stacks are
+         * formatted on `jobs` threads (0 for every core), with the same
+         * bytes. */
+        void dump(std::ostream& os, unsigned jobs = 0) const;
+};
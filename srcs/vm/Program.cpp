@@ -0,0 +1,45 @@
+#include "Program.hpp"
+#include "../parser/InputReader.hpp"
+
+static constexpr size_t kBatchSize = 10000;
+
+Program::Program() : _hasExit(false)
+{
+}
+
+Program::~Program()
+{
+}
+
+void Program::compile(inputReader& input)
+{
+    for (size_t linesRead = input.readProgram(kBatchSize); linesRead > 0; linesRead = input.readProgram(kBatchSize))
+    {
+        for (Line line = input.getLine(); line.no != 0; line = input.getLine())
+        {
+            Error err = _code.append(line);
+            if (err.failed())
+                err.raise();
+            if (!_code.empty() && _code.back().op == OpCode::Exit && !_code.pending())
+            {
+                _hasExit = true;
+                return;
+            }
+        }
+    }
+    Error err = _code.close();
+    if (err.failed())
+        err.raise();
+}
+
+bool Program::save(std::string& out) const
+{
+    putBytes(out, static_cast<uint8_t>(_hasExit));
+    return _code.save(out);
+}
+
+bool Program::load(ByteReader& in)
+{
+    _hasExit = in.get<uint8_t>() != 0;
+    return _code.load(in) && in.remaining() == 0;
+}
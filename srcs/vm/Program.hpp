@@ -0,0 +1,35 @@
+#pragma once
+#include "Assembler.hpp"
+
+class inputReader;
+
+/* A fully parsed program. Immutable once compiled, so one instance can be
+ * shared by any number of vm instances running on different threads. */
+class Program
+{
+    private:
+        Assembler _code;
+        bool _hasExit;
+
+        Program(const Program& other);
+        const Program& operator=(const Program& other);
+
+    public:
+        Program();
+        ~Program();
+
+        /* Lexes, parses and links every line up to and including the first
+         * exit after which no jump or repeat is left waiting; later lines
+         * are never looked at, as in line-by-line mode. Lexical, syntax
+         * and link errors are thrown. */
+        void compile(inputReader& input);
+
+        /* Run it with a Runner. */
+        const Assembler& code() const { return _code; }
+        bool hasExit() const { return _hasExit; }
+
+        /* Binary form for the CompileCache: save() is false for a program
+         * it cannot hold, load() for malformed data. */
+        bool save(std::string& out) const;
+        bool load(ByteReader& in);
+};
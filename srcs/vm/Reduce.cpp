@@ -0,0 +1,140 @@
+#include <algorithm>
+#include "Reduce.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <immintrin.h>
+  #define AVM_REDUCE_X86 1
+#endif
+
+namespace
+{
+    int64_t m_scalar(reduce::Kind kind, const OperandValue* v, size_t n)
+    {
+        uint64_t acc = static_cast<uint64_t>(v[0].i);
+
+        switch (kind)
+        {
+            case reduce::Kind::Sum:
+                for (size_t i = 1; i < n; ++i)
+                    acc += static_cast<uint64_t>(v[i].i);
+                break;
+            case reduce::Kind::Prod:
+                for (size_t i = 1; i < n; ++i)
+                    acc *= static_cast<uint64_t>(v[i].i);
+                break;
+            case reduce::Kind::Min:
+                for (size_t i = 1; i < n; ++i)
+                    acc = static_cast<uint64_t>(std::min(static_cast<int64_t>(acc), v[i].i));
+                break;
+            case reduce::Kind::Max:
+                for (size_t i = 1; i < n; ++i)
+                    acc = static_cast<uint64_t>(std::max(static_cast<int64_t>(acc), v[i].i));
+                break;
+        }
+        return static_cast<int64_t>(acc);
+    }
+
+#ifdef AVM_REDUCE_X86
+    /* Folds the 2 or 4 lanes of a vector kernel with the scalar rule. */
+    int64_t m_lanes(reduce::Kind kind, const int64_t* lanes, size_t count)
+    {
+        OperandValue v[4];
+        for (size_t i = 0; i < count; ++i)
+            v[i].i = lanes[i];
+        return m_scalar(kind, v, count);
+    }
+
+    /* SSE2 (x86-64 baseline). 64-bit lanes; products only keep the low
+     * 32 bits, which is all an Int8/16/32 result needs. */
+    int64_t m_sse2(reduce::Kind kind, const OperandValue* v, size_t n)
+    {
+        const __m128i* p = reinterpret_cast<const __m128i*>(v);
+        size_t blocks = n / 2;
+        __m128i acc = _mm_loadu_si128(p);
+        alignas(16) int64_t lanes[2];
+
+        for (size_t b = 1; b < blocks; ++b)
+        {
+            __m128i x = _mm_loadu_si128(p + b);
+            switch (kind)
+            {
+                case reduce::Kind::Sum:
+                    acc = _mm_add_epi64(acc, x);
+                    break;
+                case reduce::Kind::Prod:
+                    acc = _mm_mul_epu32(acc, x);
+                    break;
+                case reduce::Kind::Min:
+                case reduce::Kind::Max:
+                {
+                    /* Values fit in 32 bits: compare the low dwords and
+                     * widen the mask to the whole 64-bit lane. */
+                    __m128i gt = _mm_cmpgt_epi32(acc, x);
+                    gt = _mm_shuffle_epi32(gt, _MM_SHUFFLE(2, 2, 0, 0));
+                    __m128i keepX = (kind == reduce::Kind::Min) ? gt : _mm_xor_si128(gt, _mm_set1_epi32(-1));
+                    acc = _mm_or_si128(_mm_and_si128(keepX, x), _mm_andnot_si128(keepX, acc));
+                    break;
+                }
+            }
+        }
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc);
+
+        OperandValue rest[2];
+        rest[0].i = m_lanes(kind, lanes, 2);
+        size_t restCount = 1;
+        if (n % 2)
+            rest[restCount++] = v[n - 1];
+        return m_scalar(kind, rest, restCount);
+    }
+
+    __attribute__((target("avx2")))
+    int64_t m_avx2(reduce::Kind kind, const OperandValue* v, size_t n)
+    {
+        const __m256i* p = reinterpret_cast<const __m256i*>(v);
+        size_t blocks = n / 4;
+        __m256i acc = _mm256_loadu_si256(p);
+        alignas(32) int64_t lanes[4];
+
+        for (size_t b = 1; b < blocks; ++b)
+        {
+            __m256i x = _mm256_loadu_si256(p + b);
+            switch (kind)
+            {
+                case reduce::Kind::Sum:
+                    acc = _mm256_add_epi64(acc, x);
+                    break;
+                case reduce::Kind::Prod:
+                    acc = _mm256_mul_epu32(acc, x);
+                    break;
+                case reduce::Kind::Min:
+                    acc = _mm256_blendv_epi8(acc, x, _mm256_cmpgt_epi64(acc, x));
+                    break;
+                case reduce::Kind::Max:
+                    acc = _mm256_blendv_epi8(acc, x, _mm256_cmpgt_epi64(x, acc));
+                    break;
+            }
+        }
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+
+        OperandValue rest[4];
+        rest[0].i = m_lanes(kind, lanes, 4);
+        size_t restCount = 1;
+        for (size_t i = blocks * 4; i < n; ++i)
+            rest[restCount++] = v[i];
+        return m_scalar(kind, rest, restCount);
+    }
+#endif
+}
+
+int64_t reduce::integers(Kind kind, const OperandValue* values, size_t n)
+{
+#ifdef AVM_REDUCE_X86
+    static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+
+    if (hasAvx2 && n >= 8)
+        return m_avx2(kind, values, n);
+    if (n >= 4)
+        return m_sse2(kind, values, n);
+#endif
+    return m_scalar(kind, values, n);
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "../operand/OperandValue.hpp"
+
+/* Bulk kernels for the sum/prod/min/max instructions over a run of
+ * integer slots that all share one type.
+ * Integer slots are sign-extended int64, and wrap-around in an N-bit type
+ * is arithmetic modulo 2^N, so sums and products can be accumulated in any
+ * order and truncated once at the end; min/max are order-independent.
+ * Float and Double are never reassociated (that would change rounding);
+ * the VM folds those one by one like chained Operand::operate calls.
+ */
+namespace reduce
+{
+    enum class Kind { Sum, Prod, Min, Max };
+
+    /* Result before truncation to the element type. `n` must be > 0. */
+    int64_t integers(Kind kind, const OperandValue* values, size_t n);
+}
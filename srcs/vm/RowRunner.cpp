@@ -0,0 +1,74 @@
+#include <fstream>
+#include <sstream>
+#include "RowRunner.hpp"
+#include "Runner.hpp"
+#include "../exception/Exception.hpp"
+#include "../parser/Lexer.hpp"
+#include "../parser/Parser.hpp"
+#include "../utils/Parallel.hpp"
+
+std::vector<std::string> RowRunner::readRows(const std::string& path)
+{
+    std::ifstream in(path);
+    std::vector<std::string> rows;
+    std::string line;
+
+    if (!in.is_open())
+        throw FailedToOpenFile(path);
+    while (std::getline(in, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        rows.push_back(line);
+    }
+    return rows;
+}
+
+RowResult RowRunner::m_runRow(const Program& program, const std::string& row, size_t rowNo, size_t loadLimit,
+                              bool checked)
+{
+    std::ostringstream out;
+    RowResult result;
+    vm machine(out);
+
+    machine.setJobs(1);
+    machine.setCheckedArithmetic(checked);
+    if (loadLimit)
+        machine.setLoadLimit(loadLimit);
+    try
+    {
+        std::istringstream cells(row);
+        std::string cell;
+        ConstantPool seeds;
+        while (std::getline(cells, cell, ','))
+        {
+            Line seed{rowNo, "push " + cell};
+            machine.executeInstruction(Parser::parseInstruction(Lexer::tokenize(seed), seeds), seeds);
+        }
+
+        Runner runner(machine, program.code());
+        Error err = runner.run();
+        if (err.failed())
+            err.raise();
+        if (!machine.halted())
+            result.error = "No exit instruction found.";
+    }
+    catch (const std::exception& e)
+    {
+        result.error = e.what();
+    }
+    result.output = out.str();
+    return result;
+}
+
+std::vector<RowResult> RowRunner::run(const Program& program, const std::vector<std::string>& rows,
+                                      unsigned jobs, size_t loadLimit, bool checked)
+{
+    std::vector<RowResult> results(rows.size());
+
+    parallelFor(rows.size(), jobs, [&](size_t i) {
+        if (!rows[i].empty())
+            results[i] = m_runRow(program, rows[i], i + 1, loadLimit, checked);
+    });
+    return results;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Program.hpp"
+
+/* Runs one compiled Program over many input rows in parallel.
+ * Each row gets a fresh vm whose stack is seeded from the row's cells,
+ * pushed left to right (the last cell ends on top). Cells use the
+ * instruction value syntax, e.g. "int32(42),double(1.5)".
+ */
+struct RowResult
+{
+    std::string output;
+    std::string error;      /* empty when the row ran to its exit */
+};
+
+class RowRunner
+{
+    private:
+        RowRunner();
+        RowRunner(const RowRunner& other);
+        const RowRunner& operator=(const RowRunner& other);
+        ~RowRunner();
+
+        static RowResult m_runRow(const Program& program, const std::string& row, size_t rowNo, size_t loadLimit,
+                                  bool checked);
+
+    public:
+        /* Reads CSV rows from `path`. Blank lines are kept as rows, so
+         * later rows keep their numbers; run() gives them no output and
+         * no error. */
+        static std::vector<std::string> readRows(const std::string& path);
+
+        /* Results are returned in row order whatever the scheduling.
+         * A loadLimit of 0 keeps the vm default; `checked` as for
+         * vm::setCheckedArithmetic. */
+        static std::vector<RowResult> run(const Program& program, const std::vector<std::string>& rows,
+                                          unsigned jobs, size_t loadLimit, bool checked);
+};
@@ -0,0 +1,105 @@
+#include <algorithm>
+#include "Runner.hpp"
+
+static const ErrorDesc m_repeatCount = { ErrorKind::InvalidValue, "Repeat count must not be negative at line %l: %s" };
+
+Runner::Runner(vm& machine, const Assembler& code) : _vm(machine), _code(code), _pc(0)
+{
+}
+
+Runner::~Runner()
+{
+}
+
+/* A repeat entered again (after a jump out of its body, or as the inner
+ * loop of an outer one) restarts its count; loops above it are dropped. */
+Error Runner::m_enterLoop(const Instruction& instr, size_t at)
+{
+    const Constant& count = _code.constants()[instr.constant];
+
+    if (count.error.failed())
+        return count.error;
+    if (count.value.i < 0)
+        return Error(m_repeatCount, instr.line, 0, count.literal);
+    while (!_loops.empty() && _loops.back().start >= at)
+        _loops.pop_back();
+    if (count.value.i == 0)
+        _pc = instr.target;
+    else
+        _loops.push_back(Loop{at, instr.target, count.value.i});
+    return Error();
+}
+
+/* An end reached without its repeat running (a jump into the body) just
+ * falls through. */
+void Runner::m_endLoop(const Instruction& instr)
+{
+    auto loop = std::find_if(_loops.rbegin(), _loops.rend(), [&](const Loop& l) { return l.start == instr.target; });
+
+    if (loop == _loops.rend())
+        return;
+    _loops.erase(loop.base(), _loops.end());
+    if (--_loops.back().remaining > 0)
+        _pc = instr.target + 1;
+    else
+        _loops.pop_back();
+}
+
+Error Runner::run(size_t& budget)
+{
+    while (budget > 0 && !_vm.halted() && _pc < _code.end() && _code.linked(_pc))
+    {
+        const size_t at = _pc++;
+        const Instruction& instr = _code.at(at);
+        Error err;
+        bool zero;
+
+        --budget;
+        switch (instr.op)
+        {
+            case OpCode::Jmp:
+                _pc = instr.target;
+                break;
+            case OpCode::Jz:
+            case OpCode::Jnz:
+                err = _vm.popCondition(instr, zero);
+                if (!err.failed() && zero == (instr.op == OpCode::Jz))
+                    _pc = instr.target;
+                break;
+            case OpCode::Repeat:
+                err = m_enterLoop(instr, at);
+                break;
+            case OpCode::End:
+                m_endLoop(instr);
+                break;
+            default:
+                err = _vm.tryExecute(instr, _code.constants());
+                break;
+        }
+        if (err.failed())
+            return err;
+    }
+    return Error();
+}
+
+Error Runner::run()
+{
+    size_t unlimited = SIZE_MAX;
+    return run(unlimited);
+}
+
+size_t Runner::keepFrom() const
+{
+    size_t from = _pc;
+
+    for (const Loop& loop : _loops)
+        if (loop.end > _pc)
+            from = std::min(from, loop.start);
+    return from;
+}
+
+void Runner::restore(size_t pc, const std::vector<Loop>& loops)
+{
+    _pc = pc;
+    _loops = loops;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "vm.hpp"
+#include "Assembler.hpp"
+
+/* Executes an Assembler's instructions on one vm, following jumps and
+ * counted loops. The code may still be growing: running stops at its end
+ * or at a jump not linked yet, and resumes from there on the next call.
+ *
+ * jz/jnz pop the top value and jump if it is (not) zero. `repeat int32(N)`
+ * runs the lines up to its matching `end` N times; loops nest.
+ */
+class Runner
+{
+    public:
+        struct Loop
+        {
+            size_t start;       /* the repeat */
+            size_t end;         /* the instruction after its end */
+            int64_t remaining;
+        };
+
+    private:
+        vm& _vm;
+        const Assembler& _code;
+        size_t _pc;
+        std::vector<Loop> _loops;
+
+        Error m_enterLoop(const Instruction& instr, size_t at);
+        void m_endLoop(const Instruction& instr);
+
+        Runner();
+        Runner(const Runner& other);
+        const Runner& operator=(const Runner& other);
+
+    public:
+        Runner(vm& machine, const Assembler& code);
+        ~Runner();
+
+        /* Runs until the vm halts, the code runs out or waits for a label,
+         * or `budget` instructions have run (it is decremented). A failing
+         * instruction is stepped over and its Error returned, so calling
+         * again carries on after it. */
+        Error run(size_t& budget);
+        Error run();
+
+        /* The oldest instruction execution may still come back to; the
+         * Assembler can discard everything before it. */
+        size_t keepFrom() const;
+
+        /* Execution state, for checkpoints. */
+        size_t pc() const { return _pc; }
+        const std::vector<Loop>& loops() const { return _loops; }
+        void restore(size_t pc, const std::vector<Loop>& loops);
+};
@@ -0,0 +1,221 @@
+#include <exception>
+#include <sstream>
+#include "SegmentRunner.hpp"
+#include "../stats/MemStats.hpp"
+
+/* The stack-depth model: an instruction needs `needs` values on the stack
+ * and changes its depth by `delta`. False for instructions a segment
+ * cannot hold: dump reads the whole stack, load pushes a count known only
+ * when the file is read, exit stops everything, and a reduction with a
+ * bad count has no depth to model. */
+static bool m_stackEffect(const Instruction& instr, const ConstantPool& pool, size_t& needs, int64_t& delta)
+{
+    switch (instr.op)
+    {
+        case OpCode::Push:
+            needs = 0;
+            delta = 1;
+            return true;
+        case OpCode::Pop:
+            needs = 1;
+            delta = -1;
+            return true;
+        case OpCode::Assert:
+        case OpCode::Print:
+            needs = 1;
+            delta = 0;
+            return true;
+        case OpCode::Add:
+        case OpCode::Sub:
+        case OpCode::Mul:
+        case OpCode::Div:
+        case OpCode::Mod:
+            needs = 2;
+            delta = -1;
+            return true;
+        case OpCode::Sum:
+        case OpCode::Prod:
+        case OpCode::Min:
+        case OpCode::Max:
+        {
+            const Constant& count = pool[instr.constant];
+            if (count.error.failed() || count.value.i < 1)
+                return false;
+            needs = static_cast<size_t>(count.value.i);
+            delta = 1 - count.value.i;
+            return true;
+        }
+        case OpCode::Dup:
+            needs = 1;
+            delta = 1;
+            return true;
+        case OpCode::Swap:
+            needs = 2;
+            delta = 0;
+            return true;
+        case OpCode::Over:
+            needs = 2;
+            delta = 1;
+            return true;
+        case OpCode::Rot:
+            needs = 3;
+            delta = 0;
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void m_close(std::vector<SegmentRunner::Segment>& segments, size_t begin, size_t end)
+{
+    if (end - begin >= SegmentRunner::kMinSegment)
+        segments.push_back(SegmentRunner::Segment{begin, end});
+}
+
+SegmentRunner::SegmentRunner(vm& machine, const Assembler& code, unsigned jobs)
+    : _vm(machine), _code(code), _pool(jobs), _segments(analyze(code)), _first(0), _next(0), _pc(code.base())
+{
+}
+
+SegmentRunner::~SegmentRunner()
+{
+}
+
+bool SegmentRunner::straightLine(const Assembler& code)
+{
+    for (size_t i = code.base(); i < code.end(); ++i)
+    {
+        switch (code.at(i).op)
+        {
+            case OpCode::Label:
+            case OpCode::Jmp:
+            case OpCode::Jz:
+            case OpCode::Jnz:
+            case OpCode::Repeat:
+            case OpCode::End:
+                return false;
+            default:
+                break;
+        }
+    }
+    return true;
+}
+
+/* Walks the code tracking the depth relative to the current segment's
+ * start. An instruction that needs more than that, or that the model
+ * cannot hold, ends the segment and stays outside any. Long segments are
+ * cut where the depth has just dropped and is about to rise again, which
+ * is where the next one is least likely to reach back into this one. */
+std::vector<SegmentRunner::Segment> SegmentRunner::analyze(const Assembler& code)
+{
+    const ConstantPool& pool = code.constants();
+    std::vector<Segment> segments;
+    size_t begin = code.base();
+    size_t depth = 0;
+    size_t needs;
+    int64_t delta;
+
+    for (size_t i = code.base(); i < code.end(); ++i)
+    {
+        if (!m_stackEffect(code.at(i), pool, needs, delta) || needs > depth)
+        {
+            m_close(segments, begin, i);
+            begin = i + 1;
+            depth = 0;
+            continue;
+        }
+        depth = static_cast<size_t>(static_cast<int64_t>(depth) + delta);
+
+        const size_t length = i + 1 - begin;
+        size_t nextNeeds;
+        int64_t nextDelta;
+        if (length >= kMaxSegment
+            || (length >= kTargetSegment && delta < 0 && i + 1 < code.end()
+                && m_stackEffect(code.at(i + 1), pool, nextNeeds, nextDelta) && nextDelta > 0))
+        {
+            m_close(segments, begin, i + 1);
+            begin = i + 1;
+            depth = 0;
+        }
+    }
+    m_close(segments, begin, code.end());
+    return segments;
+}
+
+/* No instruction in a segment reaches below its start, so it runs the
+ * same on an empty stack. Any error voids the result. */
+void SegmentRunner::m_runSegment(const Segment& segment, Result& result) const
+{
+    try
+    {
+        std::ostringstream out;
+        vm machine(out);
+        const ConstantPool& pool = _code.constants();
+
+        machine.setJobs(1);
+        machine.setCheckedArithmetic(_vm.checkedArithmetic());
+        for (size_t i = segment.begin; i < segment.end; ++i)
+            if (machine.tryExecute(_code.at(i), pool).failed())
+                return;
+
+        const OperandStack& stack = machine.stack();
+        result.tags.reserve(stack.size());
+        result.values.reserve(stack.size());
+        stack.forRange(0, stack.size(), [&](const uint8_t* tags, const OperandValue* values, size_t len) {
+            result.tags.insert(result.tags.end(), tags, tags + len);
+            result.values.insert(result.values.end(), values, values + len);
+        });
+        result.output = out.str();
+        result.ok = true;
+    }
+    catch (const std::exception&)
+    {
+        result.ok = false;
+    }
+}
+
+/* Segments are run a window at a time, two per job, so results waiting
+ * to be spliced stay bounded. */
+const SegmentRunner::Result& SegmentRunner::m_result(size_t segment)
+{
+    if (segment < _first || segment >= _first + _results.size())
+    {
+        const size_t n = std::min<size_t>(size_t(_pool.jobs()) * 2, _segments.size() - segment);
+        _results.clear();
+        _results.resize(n);
+        _first = segment;
+        _pool.run(n, [&](size_t k) { m_runSegment(_segments[segment + k], _results[k]); });
+    }
+    return _results[segment - _first];
+}
+
+void SegmentRunner::m_splice(const Result& result)
+{
+    OperandStack& stack = _vm.stack();
+
+    _vm.output() << result.output;
+    for (size_t i = 0; i < result.values.size(); ++i)
+        stack.push(static_cast<eOperandType>(result.tags[i]), result.values[i]);
+    MemStats::noteStackDepth(stack.size());
+}
+
+Error SegmentRunner::run()
+{
+    while (!_vm.halted() && _pc < _code.end())
+    {
+        if (_next < _segments.size() && _pc == _segments[_next].begin)
+        {
+            const Result& result = m_result(_next++);
+            if (result.ok)
+            {
+                m_splice(result);
+                _pc = _segments[_next - 1].end;
+                continue;
+            }
+        }
+        const Error err = _vm.tryExecute(_code.at(_pc++), _code.constants());
+        if (err.failed())
+            return err;
+    }
+    return Error();
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "vm.hpp"
+#include "Assembler.hpp"
+#include "../utils/Parallel.hpp"
+
+/* Runs a straight-line program (no labels, jumps or loops) on several
+ * cores. A static stack-depth model splits the code into segments that
+ * never read a value pushed before they started: everything they do
+ * depends on their own constants only. Each segment runs ahead on a vm of
+ * its own; when execution reaches it, the values it left and the output
+ * it printed are spliced onto the main vm in program order.
+ *
+ * Instructions outside segments (dump, load, exit, and anything that
+ * reaches below its segment) run on the main vm as usual. A segment that
+ * hit an error is thrown away and executed there instead, so output,
+ * errors and the final stack are those of a sequential run.
+ */
+class SegmentRunner
+{
+    public:
+        struct Segment
+        {
+            size_t begin;
+            size_t end;
+        };
+
+        /* Shorter stretches are not worth a vm of their own. */
+        static constexpr size_t kMinSegment = 4096;
+        /* Segments are cut at the next drop in depth after this length,
+         * and unconditionally at kMaxSegment. */
+        static constexpr size_t kTargetSegment = 64 * 1024;
+        static constexpr size_t kMaxSegment = 4 * kTargetSegment;
+
+    private:
+        struct Result
+        {
+            bool ok = false;
+            std::string output;
+            std::vector<uint8_t> tags;
+            std::vector<OperandValue> values;
+        };
+
+        vm& _vm;
+        const Assembler& _code;
+        WorkerPool _pool;
+        std::vector<Segment> _segments;
+        std::vector<Result> _results;   /* a window of segments, from _first */
+        size_t _first;
+        size_t _next;                   /* the next segment to reach */
+        size_t _pc;
+
+        const Result& m_result(size_t segment);
+        void m_runSegment(const Segment& segment, Result& result) const;
+        void m_splice(const Result& result);
+
+        SegmentRunner();
+        SegmentRunner(const SegmentRunner& other);
+        const SegmentRunner& operator=(const SegmentRunner& other);
+
+    public:
+        /* `jobs` as for parallelFor. */
+        SegmentRunner(vm& machine, const Assembler& code, unsigned jobs);
+        ~SegmentRunner();
+
+        /* True if `code` has no control flow, so segments can run ahead. */
+        static bool straightLine(const Assembler& code);
+        static std::vector<Segment> analyze(const Assembler& code);
+
+        /* As Runner::run: runs until the vm halts or the code runs out; a
+         * failing instruction is stepped over and its Error returned. */
+        Error run();
+
+        size_t segments() const { return _segments.size(); }
+};
@@ -0,0 +1,188 @@
+#include <algorithm>
+#include "Session.hpp"
+
+SessionTask& SessionTask::operator=(SessionTask&& other) noexcept
+{
+    if (this != &other)
+    {
+        if (_handle)
+            _handle.destroy();
+        _handle = other._handle;
+        other._handle = nullptr;
+    }
+    return *this;
+}
+
+SessionTask::~SessionTask()
+{
+    if (_handle)
+        _handle.destroy();
+}
+
+SuspendReason SessionTask::resume()
+{
+    if (!_handle || _handle.done())
+        return SuspendReason::Done;
+    _handle.resume();
+    return _handle.promise().reason;
+}
+
+Session::Session(const std::string& name, size_t slice, bool checked)
+    : _name(name), _slice(std::max<size_t>(1, slice)), _lineNo(0), _closed(false), _out(), _vm(_out), _runner(_vm, _code),
+      _ok(false), _state(SuspendReason::NeedInput), _queued(false)
+{
+    _vm.setJobs(1);
+    _vm.setCheckedArithmetic(checked);
+    _task = m_body();
+}
+
+Session::~Session()
+{
+}
+
+/* The program loop. Errors end the session instead of escaping the
+ * coroutine, so the scheduler never sees them; an exception that does
+ * escape (bad_alloc from a push) ends it too, see resume(). */
+SessionTask Session::m_body()
+{
+    size_t budget = _slice;
+
+    while (true)
+    {
+        Error err = _runner.run(budget);
+        if (err.failed())
+        {
+            _error = err.message();
+            co_return;
+        }
+        if (_vm.halted())
+        {
+            _ok = true;
+            co_return;
+        }
+        if (static_cast<size_t>(_out.tellp()) >= kOutputCapacity)
+            co_yield SuspendReason::OutputFull;
+        if (budget == 0)
+        {
+            budget = _slice;
+            co_yield SuspendReason::SliceExhausted;
+            continue;
+        }
+
+        /* The runner has caught up with the code: it needs another line. */
+        if (_pending.empty())
+        {
+            if (!_closed)
+            {
+                co_yield SuspendReason::NeedInput;
+                continue;
+            }
+            if (_code.pending())
+            {
+                _code.close();
+                continue;
+            }
+            _error = "No exit instruction found.";
+            co_return;
+        }
+        _code.discardBefore(_runner.keepFrom());
+        _code.append(_pending.front());
+        _pending.pop_front();
+    }
+}
+
+void Session::feed(const std::string& line)
+{
+    _pending.push_back(Line{++_lineNo, line});
+}
+
+void Session::close()
+{
+    _closed = true;
+}
+
+SuspendReason Session::resume()
+{
+    _state = _task.resume();
+    if (_state == SuspendReason::Done && _task.exception() && _error.empty())
+    {
+        try
+        {
+            std::rethrow_exception(_task.exception());
+        }
+        catch (const std::exception& e)
+        {
+            _error = e.what();
+        }
+        catch (...)
+        {
+            _error = "Unknown error";
+        }
+    }
+    return _state;
+}
+
+std::string Session::takeOutput()
+{
+    std::string s = _out.str();
+    _out.str(std::string());
+    return s;
+}
+
+Scheduler::Scheduler(OutputSink sink, size_t slice, bool checked) : _sink(sink), _slice(slice), _checked(checked)
+{
+}
+
+Scheduler::~Scheduler()
+{
+}
+
+void Scheduler::m_enqueue(Session& session)
+{
+    if (session._queued || session.finished())
+        return;
+    session._queued = true;
+    _ready.push_back(&session);
+}
+
+Session& Scheduler::add(const std::string& name)
+{
+    _sessions.push_back(std::make_unique<Session>(name, _slice, _checked));
+    m_enqueue(*_sessions.back());
+    return *_sessions.back();
+}
+
+void Scheduler::feed(Session& session, const std::string& line)
+{
+    session.feed(line);
+    m_enqueue(session);
+}
+
+void Scheduler::close(Session& session)
+{
+    session.close();
+    m_enqueue(session);
+}
+
+size_t Scheduler::run()
+{
+    while (!_ready.empty())
+    {
+        Session* s = _ready.front();
+        _ready.pop_front();
+        s->_queued = false;
+
+        SuspendReason reason = s->resume();
+        std::string out = s->takeOutput();
+        if (!out.empty())
+            _sink(*s, out);
+
+        /* NeedInput parks the session until feed() or close(); the other
+         * reasons go to the back of the queue for fairness. */
+        if (reason != SuspendReason::Done && !s->waitingForInput())
+            m_enqueue(*s);
+    }
+
+    return static_cast<size_t>(std::count_if(_sessions.begin(), _sessions.end(),
+        [](const std::unique_ptr<Session>& s) { return s->waitingForInput(); }));
+}
@@ -0,0 +1,146 @@
+#pragma once
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "vm.hpp"
+#include "Runner.hpp"
+#include "../parser/InputReader.hpp"
+
+/* Resumable program sessions on C++20 coroutines.
+ * A Session runs one program as input lines are fed to it and suspends
+ * instead of blocking: when it has no input, when its output buffer is
+ * full, or when it used up its instruction slice. A Scheduler resumes
+ * ready sessions round-robin, so one thread can multiplex many mostly
+ * idle programs.
+ */
+
+enum class SuspendReason { NeedInput, OutputFull, SliceExhausted, Done };
+
+class SessionTask
+{
+    public:
+        struct promise_type
+        {
+            SuspendReason reason = SuspendReason::NeedInput;
+            std::exception_ptr exception;
+
+            SessionTask get_return_object() { return SessionTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            std::suspend_always final_suspend() noexcept { return {}; }
+            std::suspend_always yield_value(SuspendReason r) noexcept { reason = r; return {}; }
+            void return_void() noexcept { reason = SuspendReason::Done; }
+            void unhandled_exception() noexcept
+            {
+                exception = std::current_exception();
+                reason = SuspendReason::Done;
+            }
+        };
+
+    private:
+        std::coroutine_handle<promise_type> _handle;
+
+        SessionTask(const SessionTask& other);
+        const SessionTask& operator=(const SessionTask& other);
+
+    public:
+        SessionTask() : _handle(nullptr) {}
+        explicit SessionTask(std::coroutine_handle<promise_type> h) : _handle(h) {}
+        SessionTask(SessionTask&& other) noexcept : _handle(other._handle) { other._handle = nullptr; }
+        SessionTask& operator=(SessionTask&& other) noexcept;
+        ~SessionTask();
+
+        SuspendReason resume();
+        /* What escaped the coroutine and finished it, if anything. */
+        std::exception_ptr exception() const { return _handle ? _handle.promise().exception : nullptr; }
+};
+
+class Session
+{
+    private:
+        static constexpr size_t kOutputCapacity = 64 * 1024;
+
+        std::string _name;
+        size_t _slice;
+        std::deque<Line> _pending;
+        size_t _lineNo;
+        bool _closed;
+        std::ostringstream _out;
+        vm _vm;
+        Assembler _code;
+        Runner _runner;
+        bool _ok;
+        std::string _error;
+        SuspendReason _state;
+        bool _queued;       /* in the scheduler's ready queue */
+        SessionTask _task;
+
+        friend class Scheduler;
+
+        SessionTask m_body();
+
+        Session();
+        Session(const Session& other);
+        const Session& operator=(const Session& other);
+
+    public:
+        /* `slice` is the number of instructions run per resume; `checked`
+         * as for vm::setCheckedArithmetic. */
+        Session(const std::string& name, size_t slice, bool checked);
+        ~Session();
+
+        void feed(const std::string& line);
+        /* No more input will come; a program without exit then fails. */
+        void close();
+
+        SuspendReason resume();
+        SuspendReason state() const { return _state; }
+        bool waitingForInput() const { return _state == SuspendReason::NeedInput && _pending.empty() && !_closed; }
+        bool finished() const { return _state == SuspendReason::Done; }
+
+        /* Hands over everything written since the last call. */
+        std::string takeOutput();
+
+        const std::string& name() const { return _name; }
+        bool ok() const { return _ok; }
+        const std::string& error() const { return _error; }
+};
+
+class Scheduler
+{
+    public:
+        /* Receives each chunk of a session's output as it is drained. */
+        typedef std::function<void(Session&, const std::string&)> OutputSink;
+
+    private:
+        std::vector<std::unique_ptr<Session>> _sessions;
+        std::deque<Session*> _ready;
+        OutputSink _sink;
+        size_t _slice;
+        bool _checked;
+
+        void m_enqueue(Session& session);
+
+        Scheduler();
+        Scheduler(const Scheduler& other);
+        const Scheduler& operator=(const Scheduler& other);
+
+    public:
+        /* Sessions are made with `slice` and `checked` (see Session). */
+        Scheduler(OutputSink sink, size_t slice, bool checked);
+        ~Scheduler();
+
+        Session& add(const std::string& name);
+        void feed(Session& session, const std::string& line);
+        void close(Session& session);
+
+        /* Resumes ready sessions round-robin until every session is either
+         * finished or waiting for input. Returns the number still waiting. */
+        size_t run();
+
+        const std::vector<std::unique_ptr<Session>>& sessions() const { return _sessions; }
+};
@@ -0,0 +1,171 @@
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <string_view>
+#include <thread>
+#include "Watcher.hpp"
+#include "MappedFile.hpp"
+#include "../exception/Exception.hpp"
+
+static constexpr size_t kBatchSize = 10000;
+
+Watcher::Watcher(const std::string& path, bool checked, size_t loadLimit)
+    : _path(path), _checked(checked), _loadLimit(loadLimit), _interval(kFirstInterval)
+{
+}
+
+Watcher::~Watcher()
+{
+}
+
+size_t Watcher::unchangedMarks() const
+{
+    MappedFile file;
+    uint64_t hash = Checkpoint::kFnvBasis;
+    uint64_t at = 0;
+    size_t k = 0;
+
+    if (_marks.empty() || file.map(_path, SIZE_MAX).failed())
+        return 0;
+    for (; k < _marks.size() && _marks[k].snapshot.inputEnd <= file.size(); ++k)
+    {
+        const Snapshot& s = _marks[k].snapshot;
+        hash = Checkpoint::hash(hash, file.data() + at, s.inputEnd - at);
+        at = s.inputEnd;
+        if (hash != s.inputHash)
+            break;
+    }
+    return k;
+}
+
+uint64_t Watcher::restartLine(size_t keep) const
+{
+    return keep ? _marks[keep - 1].snapshot.lastLine + 1 : 1;
+}
+
+size_t Watcher::m_bytes(const Mark& mark)
+{
+    const Snapshot& s = mark.snapshot;
+    return s.tags.size() + s.values.size() * sizeof(OperandValue) + s.loops.size() * sizeof(Runner::Loop);
+}
+
+void Watcher::m_addMark(Mark mark)
+{
+    _marks.push_back(std::move(mark));
+    if (_marks.size() > kMaxMarks)
+    {
+        /* Keep the newest and every other one before it. */
+        std::vector<Mark> kept;
+        for (size_t i = _marks.size() % 2 == 0 ? 1 : 0; i < _marks.size(); i += 2)
+            kept.push_back(std::move(_marks[i]));
+        _marks.swap(kept);
+        _interval *= 2;
+    }
+
+    /* Any subset of the marks keeps its prefix hashes valid. */
+    size_t bytes = 0;
+    size_t drop = 0;
+    for (const Mark& m : _marks)
+        bytes += m_bytes(m);
+    while (drop < _marks.size() && bytes > kMaxSnapshotBytes)
+        bytes -= m_bytes(_marks[drop++]);
+    _marks.erase(_marks.begin(), _marks.begin() + static_cast<std::ptrdiff_t>(drop));
+}
+
+bool Watcher::run(size_t keep)
+{
+    std::error_code ec;
+    const uint64_t inputSize = std::filesystem::file_size(_path, ec);
+    std::ostringstream out;
+    vm machine(out);
+    Assembler code;
+    Runner runner(machine, code);
+    uint64_t hash = Checkpoint::kFnvBasis;
+    size_t sinceMark = 0;
+    std::string failure;
+
+    if (_loadLimit)
+        machine.setLoadLimit(_loadLimit);
+    machine.setCheckedArithmetic(_checked);
+    _marks.resize(keep);
+    try
+    {
+        inputReader input(_path, false);
+        Error err;
+
+        if (keep > 0)
+        {
+            const Mark& from = _marks.back();
+            out << std::string_view(_output).substr(0, from.outputLength);
+            Checkpoint::restore(from.snapshot, input, code, runner, machine);
+            hash = from.snapshot.inputHash;
+        }
+        while (!err.failed() && !machine.halted() && input.readProgram(kBatchSize) > 0)
+        {
+            code.discardBefore(runner.keepFrom());
+            for (Line line = input.getLine(); line.no != 0; line = input.getLine())
+            {
+                hash = Checkpoint::hash(Checkpoint::hash(hash, line.text.data(), line.text.size()), "\n", 1);
+                code.append(line);
+                err = runner.run();
+                if (err.failed() || machine.halted())
+                    break;
+                if (++sinceMark == _interval)
+                {
+                    sinceMark = 0;
+                    m_addMark(Mark{static_cast<size_t>(out.tellp()),
+                                   Checkpoint::capture(runner, code, machine, line, inputSize, hash)});
+                }
+            }
+        }
+        if (!err.failed() && !machine.halted())
+        {
+            code.close();
+            err = runner.run();
+        }
+        if (err.failed())
+            failure = err.message();
+        else if (!machine.halted())
+            failure = "No exit instruction found.";
+    }
+    catch (const std::exception& e)
+    {
+        failure = e.what();
+    }
+
+    _output = out.str();
+    std::cout << _output;
+    std::cout.flush();
+    if (!failure.empty())
+        std::cerr << failure << "\n";
+    return failure.empty();
+}
+
+int Watcher::watch()
+{
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    fs::file_time_type stamp = fs::last_write_time(_path, ec);
+    uintmax_t size = fs::file_size(_path, ec);
+
+    if (ec)
+        throw FailedToOpenFile(_path);
+    run(0);
+    while (true)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(kPollMs));
+        fs::file_time_type nowStamp = fs::last_write_time(_path, ec);
+        uintmax_t nowSize = ec ? 0 : fs::file_size(_path, ec);
+        if (ec)
+            return 0;
+        if (nowStamp == stamp && nowSize == size)
+            continue;
+        stamp = nowStamp;
+        size = nowSize;
+
+        size_t keep = unchangedMarks();
+        std::cerr << "-- " << _path << " changed, re-running from line " << restartLine(keep) << " --\n";
+        run(keep);
+    }
+}
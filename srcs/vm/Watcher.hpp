@@ -0,0 +1,66 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Checkpoint.hpp"
+
+/* --watch: runs a program file, then runs it again whenever it changes,
+ * re-executing only from the first edited line.
+ *
+ * Every `interval` lines a run keeps a Mark: a Snapshot of the state, the
+ * length of the output so far, and an FNV-1a hash of every input byte
+ * before the mark. After a change the new file is hashed up to the first
+ * mark that no longer matches; the run restarts from the mark before it,
+ * replaying the output cached up to there. At most kMaxMarks are kept:
+ * beyond that every other one is dropped and the interval doubles, which
+ * leaves the remaining prefix hashes valid. Snapshots hold at most
+ * kMaxSnapshotBytes together; past that the oldest marks are dropped, so
+ * an edit before the first one left re-runs the whole file.
+ */
+class Watcher
+{
+    private:
+        static constexpr size_t kMaxMarks = 64;
+        static constexpr size_t kMaxSnapshotBytes = size_t(256) << 20;
+        static constexpr size_t kFirstInterval = 10000;
+        static constexpr int kPollMs = 200;
+
+        struct Mark
+        {
+            size_t outputLength;
+            Snapshot snapshot;      /* its inputHash is the prefix hash */
+        };
+
+        std::string _path;
+        bool _checked;
+        size_t _loadLimit;
+        std::vector<Mark> _marks;
+        size_t _interval;
+        std::string _output;
+
+        static size_t m_bytes(const Mark& mark);
+        void m_addMark(Mark mark);
+
+        Watcher();
+        Watcher(const Watcher& other);
+        const Watcher& operator=(const Watcher& other);
+
+    public:
+        /* `loadLimit` 0 keeps the vm's default. */
+        Watcher(const std::string& path, bool checked, size_t loadLimit);
+        ~Watcher();
+
+        /* Runs until the file is deleted. Each run prints the program's
+         * output to stdout and its error, if any, to stderr. */
+        int watch();
+
+        /* How many leading marks the file on disk still agrees with. */
+        size_t unchangedMarks() const;
+        /* The first line a run keeping `keep` marks executes. */
+        uint64_t restartLine(size_t keep) const;
+        /* Runs the program from the start, or from the last of the first
+         * `keep` marks, printing the output cached before it first.
+         * Returns false if it failed. */
+        bool run(size_t keep);
+};
@@ -1,180 +1,542 @@
 #include "vm.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <limits>
 #include <iostream>
 #include "../exception/Exception.hpp"
+#include "../operand/Arithmetic.hpp"
+#include "Reduce.hpp"
+#include "MappedFile.hpp"
 #include "../debug_log.hpp"
+#include "../profiler/Profiler.hpp"
+#include "../stats/MemStats.hpp"
+#include "../trace/Trace.hpp"
 
-void m_print_instruction(const Instruction& instr)
+void m_print_instruction(const Instruction& instr, const ConstantPool& pool)
 {
 #ifdef PRINT_PARSED_INSTRUCTIONS
-    std::cout << "Instruction at line " << instr.line << ": opcode ";
-    switch (instr.op)
-    {
-        case OpCode::Push: std::cout << "Push"; break;
-        case OpCode::Pop: std::cout << "Pop"; break;
-        case OpCode::Dump: std::cout << "Dump"; break;
-        case OpCode::Assert: std::cout << "Assert"; break;
-        case OpCode::Add: std::cout << "Add"; break;
-        case OpCode::Sub: std::cout << "Sub"; break;
-        case OpCode::Mul: std::cout << "Mul"; break;
-        case OpCode::Div: std::cout << "Div"; break;
-        case OpCode::Mod: std::cout << "Mod"; break;
-        case OpCode::Print: std::cout << "Print"; break;
-        case OpCode::Exit: std::cout << "Exit"; break;
-        default: std::cout << "Unknown"; break;
-    }
-    if (instr.arg.has_value())
+    std::cout << "Instruction at line " << instr.line << ": opcode " << opName(instr.op);
+    if (instr.constant != ConstantPool::kNone)
     {
-        std::cout << ", argument type: " << typeName(instr.arg->type);
-        std::cout << ", literal: " << instr.arg->literal;
+        std::cout << ", argument type: " << typeName(pool[instr.constant].type);
+        std::cout << ", literal: " << pool[instr.constant].literal;
     }
     std::cout << std::endl;
 #else
     (void)instr; // KCH
+    (void)pool;
 #endif
 }
 
 
-void vm::performOperation(const Instruction& instr)
+static const ErrorDesc m_operationUnderflow = { ErrorKind::StackUnderflow, "Not enough values on stack for operation" };
+static const ErrorDesc m_divisionByZero = { ErrorKind::DivisionByZero, "Error: Division by zero" };
+static const ErrorDesc m_overflow[3] = {
+    { ErrorKind::Overflow, "Int8 overflow at line %l: %s" },
+    { ErrorKind::Overflow, "Int16 overflow at line %l: %s" },
+    { ErrorKind::Overflow, "Int32 overflow at line %l: %s" }
+};
+static const ErrorDesc m_underflow[3] = {
+    { ErrorKind::Underflow, "Int8 underflow at line %l: %s" },
+    { ErrorKind::Underflow, "Int16 underflow at line %l: %s" },
+    { ErrorKind::Underflow, "Int32 underflow at line %l: %s" }
+};
+static const ErrorDesc m_reductionCount = { ErrorKind::InvalidValue, "Reduction count must be positive at line %l: %s" };
+static const ErrorDesc m_reductionUnderflow = { ErrorKind::StackUnderflow, "Not enough values on stack for reduction" };
+static const ErrorDesc m_loadInvalidValue = { ErrorKind::InvalidValue, "%s" };
+static const ErrorDesc m_loadUnderflow = { ErrorKind::Underflow, "%s" };
+static const ErrorDesc m_loadOverflow = { ErrorKind::Overflow, "%s" };
+static const ErrorDesc m_loadHeaderType = { ErrorKind::InvalidOperandType, "Load header type mismatch at line %l: %s" };
+static const ErrorDesc m_loadHeaderCount = { ErrorKind::InvalidValue, "Load header count does not match file size at line %l: %s" };
+static const ErrorDesc m_loadBadType = { ErrorKind::InvalidOperandType, "Invalid operand type in load." };
+static const ErrorDesc m_popEmpty = { ErrorKind::StackUnderflow, "Pop on empty stack" };
+static const ErrorDesc m_assertEmpty = { ErrorKind::StackUnderflow, "Assert on empty stack" };
+static const ErrorDesc m_assertFailed = { ErrorKind::Assertion, "Assertion failed" };
+static const ErrorDesc m_dupEmpty = { ErrorKind::StackUnderflow, "Dup on empty stack" };
+static const ErrorDesc m_swapUnderflow = { ErrorKind::StackUnderflow, "Not enough values on stack for swap" };
+static const ErrorDesc m_overUnderflow = { ErrorKind::StackUnderflow, "Not enough values on stack for over" };
+static const ErrorDesc m_rotUnderflow = { ErrorKind::StackUnderflow, "Not enough values on stack for rot" };
+static const ErrorDesc m_printEmpty = { ErrorKind::StackUnderflow, "Print on empty stack" };
+static const ErrorDesc m_conditionEmpty = { ErrorKind::StackUnderflow, "Conditional jump on empty stack" };
+static const ErrorDesc m_printNotInt8 = { ErrorKind::Assertion, "Print instruction requires top of stack to be Int8" };
+
+static arith::Op m_arithOp(OpCode op)
+{
+    switch (op)
+    {
+        case OpCode::Sub: return arith::Op::Sub;
+        case OpCode::Mul: return arith::Op::Mul;
+        case OpCode::Div: return arith::Op::Div;
+        case OpCode::Mod: return arith::Op::Mod;
+        case OpCode::Prod: return arith::Op::Mul;
+        case OpCode::Min: return arith::Op::Min;
+        case OpCode::Max: return arith::Op::Max;
+        default: return arith::Op::Add;
+    }
+}
+
+/* `range` is arith::applyChecked's result; the detail names the step. */
+static Error m_rangeError(int range, eOperandType type, int line, char op,
+                          eOperandType lt, OperandValue lhs, eOperandType rt, OperandValue rhs)
+{
+    char buf[kMaxValueChars];
+    std::string detail(buf, formatValue(buf, lt, lhs));
+
+    detail += ' ';
+    detail += op;
+    detail += ' ';
+    detail.append(buf, formatValue(buf, rt, rhs));
+    return Error(range > 0 ? m_overflow[type] : m_underflow[type], line, 0, detail);
+}
+
+/* Assert semantics: same type and same canonical text. */
+static bool m_sameCanonical(eOperandType type, OperandValue a, OperandValue b)
+{
+    char bufA[kMaxValueChars];
+    char bufB[kMaxValueChars];
+    size_t lenA = formatValue(bufA, type, a);
+    size_t lenB = formatValue(bufB, type, b);
+
+    return lenA == lenB && std::equal(bufA, bufA + lenA, bufB);
+}
+
+Error vm::performOperation(const Instruction& instr)
 {
-    IOperand const* op1;
-    IOperand const* op2;
-    IOperand const* result = nullptr;
+    const arith::Op aop = m_arithOp(instr.op);
+    const char op = arith::opChar(aop);
+    eOperandType resultType;
+    OperandValue result;
 
     if (_stack.size() < 2)
+        return Error(m_operationUnderflow, instr.line);
+    if (arith::divisorIsZero(op, _stack.typeAt(0), _stack.valueAt(0)))
+        return Error(m_divisionByZero, instr.line);
+
+    /* lhs is the second value from the top, rhs the top one. */
+    if (_checked)
+    {
+        int range = arith::applyChecked(op, _stack.typeAt(1), _stack.valueAt(1),
+                                        _stack.typeAt(0), _stack.valueAt(0), resultType, result);
+        if (range != 0)
+            return m_rangeError(range, resultType, instr.line, op, _stack.typeAt(1), _stack.valueAt(1),
+                                _stack.typeAt(0), _stack.valueAt(0));
+    }
+    else
+    {
+        resultType = arith::promote(_stack.typeAt(1), _stack.typeAt(0));
+        result = arith::kernelFor(_stack.typeAt(1), _stack.typeAt(0), aop)(_stack.valueAt(1), _stack.valueAt(0));
+    }
+    _stack.pop();
+    _stack.pop();
+    _stack.push(resultType, result);
+    return Error();
+}
+
+/* `sum int32(N)` and friends reduce the top N values to one, exactly as
+ * N - 1 chained binary instructions would: the accumulator starts as the
+ * top value and each deeper value becomes the lhs of the next step. */
+Error vm::performReduction(const Instruction& instr, const Constant& countArg)
+{
+    static const reduce::Kind kinds[] = { reduce::Kind::Sum, reduce::Kind::Prod, reduce::Kind::Min, reduce::Kind::Max };
+    const arith::Op aop = m_arithOp(instr.op);
+    const char op = arith::opChar(aop);
+    if (countArg.error.failed())
+        return countArg.error;
+    int64_t count = countArg.value.i;
+
+    if (count < 1)
+        return Error(m_reductionCount, instr.line, 0, countArg.literal);
+    if (static_cast<size_t>(count) > _stack.size())
+        return Error(m_reductionUnderflow, instr.line);
+
+    const size_t n = static_cast<size_t>(count);
+    const size_t first = _stack.size() - n;
+    const eOperandType topType = _stack.typeAt(0);
+    eOperandType accType = topType;
+    OperandValue acc = _stack.valueAt(0);
+    bool uniform = true;
+
+    _stack.forRange(first, _stack.size(), [&](const uint8_t* tags, const OperandValue*, size_t len) {
+        uniform = uniform && std::all_of(tags, tags + len, [&](uint8_t t) { return t == topType; });
+    });
+
+    /* The vector kernels wrap; checked mode folds step by step instead. */
+    if (uniform && topType <= Int32 && !_checked)
+    {
+        const reduce::Kind kind = kinds[static_cast<int>(instr.op) - static_cast<int>(OpCode::Sum)];
+        bool started = false;
+        int64_t partial = 0;
+
+        _stack.forRange(first, _stack.size(), [&](const uint8_t*, const OperandValue* values, size_t len) {
+            int64_t r = reduce::integers(kind, values, len);
+            if (started)
+            {
+                OperandValue pair[2];
+                pair[0].i = partial;
+                pair[1].i = r;
+                r = reduce::integers(kind, pair, 2);
+            }
+            partial = r;
+            started = true;
+        });
+        switch (topType)
+        {
+            case Int8: acc = makeValue<int8_t>(static_cast<int8_t>(partial)); break;
+            case Int16: acc = makeValue<int16_t>(static_cast<int16_t>(partial)); break;
+            default: acc = makeValue<int32_t>(static_cast<int32_t>(partial)); break;
+        }
+    }
+    else
+    {
+        for (size_t k = 1; k < n; ++k)
+        {
+            if (_checked)
+            {
+                OperandValue next;
+                eOperandType nextType;
+                int range = arith::applyChecked(op, _stack.typeAt(k), _stack.valueAt(k), accType, acc, nextType, next);
+                if (range != 0)
+                    return m_rangeError(range, nextType, instr.line, op, _stack.typeAt(k), _stack.valueAt(k), accType, acc);
+                acc = next;
+                accType = nextType;
+            }
+            else
+            {
+                acc = arith::kernelFor(_stack.typeAt(k), accType, aop)(_stack.valueAt(k), acc);
+                accType = arith::promote(_stack.typeAt(k), accType);
+            }
+        }
+    }
+
+    for (size_t k = 0; k < n; ++k)
+        _stack.pop();
+    _stack.push(accType, acc);
+    return Error();
+}
+
+template <typename T>
+static T m_readLE(const unsigned char* p)
+{
+    T v;
+    std::memcpy(&v, p, sizeof(T));
+    if constexpr (std::endian::native == std::endian::big && sizeof(T) > 1)
+    {
+        unsigned char* b = reinterpret_cast<unsigned char*>(&v);
+        std::reverse(b, b + sizeof(T));
+    }
+    return v;
+}
+
+template <typename T>
+static Error m_loadElements(OperandStack& stack, eOperandType type, const unsigned char* data, size_t count,
+                            const std::string& path)
+{
+    /* Validate everything first so a bad file leaves the stack untouched. */
+    if constexpr (std::is_floating_point<T>::value)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            T v = m_readLE<T>(data + i * sizeof(T));
+            if (std::isnan(v))
+                return Error(m_loadInvalidValue, 0, 0, std::string(typeName(type)) + " NaN at element " + std::to_string(i) + " of " + path);
+            if (v < -std::numeric_limits<T>::max())
+                return Error(m_loadUnderflow, 0, 0, std::string(typeName(type)) + " underflow at element " + std::to_string(i) + " of " + path);
+            if (v > std::numeric_limits<T>::max())
+                return Error(m_loadOverflow, 0, 0, std::string(typeName(type)) + " overflow at element " + std::to_string(i) + " of " + path);
+        }
+    }
+
+    stack.append(type, count, [&](OperandValue* dst, size_t offset, size_t len) {
+        const unsigned char* src = data + offset * sizeof(T);
+        for (size_t i = 0; i < len; ++i)
+            dst[i] = makeValue<T>(m_readLE<T>(src + i * sizeof(T)));
+    });
+    return Error();
+}
+
+Error vm::performLoad(const Instruction& instr, const Constant& source)
+{
+    static const size_t sizes[] = { 1, 2, 4, 4, 8 };
+    const eOperandType type = source.type;
+    const std::string& path = source.literal;
+    const size_t elemSize = sizes[type];
+    MappedFile file;
+    Error err = file.map(path, _loadLimit);
+    if (err.failed())
+        return err;
+    const unsigned char* data = file.data();
+    size_t bytes = file.size();
+
+    if (bytes >= sizeof(LoadFileHeader) && std::memcmp(data, "AVMB", 4) == 0)
+    {
+        LoadFileHeader header;
+        std::memcpy(&header, data, sizeof(header));
+        header.count = m_readLE<uint64_t>(data + offsetof(LoadFileHeader, count));
+        if (header.version != 1 || header.type != static_cast<uint8_t>(type))
+            return Error(m_loadHeaderType, instr.line, 0, path);
+        data += sizeof(header);
+        bytes -= sizeof(header);
+        if (header.count > bytes / elemSize || header.count * elemSize != bytes)
+            return Error(m_loadHeaderCount, instr.line, 0, path);
+    }
+    if (bytes % elemSize != 0)
+        return Error(m_loadInvalidValue, instr.line, 0, "Load file size is not a multiple of " + std::to_string(elemSize)
+                     + " bytes at line " + std::to_string(instr.line) + ": " + path);
+
+    const size_t count = bytes / elemSize;
+    switch (type)
+    {
+        case Int8: err = m_loadElements<int8_t>(_stack, type, data, count, path); break;
+        case Int16: err = m_loadElements<int16_t>(_stack, type, data, count, path); break;
+        case Int32: err = m_loadElements<int32_t>(_stack, type, data, count, path); break;
+        case Float: err = m_loadElements<float>(_stack, type, data, count, path); break;
+        case Double: err = m_loadElements<double>(_stack, type, data, count, path); break;
+        case None: return Error(m_loadBadType, instr.line);
+    }
+    MemStats::noteStackDepth(_stack.size());
+    return err;
+}
+
+void vm::executeInstruction(const Instruction& instr, const ConstantPool& pool)
+{
+    Error err = tryExecute(instr, pool);
+    if (err.failed())
+        err.raise();
+}
+
+Error vm::popCondition(const Instruction& instr, bool& zero)
+{
+    m_materialize();
+    if (_stack.empty())
+        return Error(m_conditionEmpty, instr.line);
+    switch (_stack.typeAt(0))
     {
-        throw StackUnderflow(instr.line, "Not enough values on stack for operation");
+        case Float: zero = _stack.valueAt(0).f == 0; break;
+        case Double: zero = _stack.valueAt(0).d == 0; break;
+        default: zero = _stack.valueAt(0).i == 0; break;
     }
+    _stack.pop();
+    return Error();
+}
 
-    op1 = dynamic_cast<IOperand const*>(_stack.back());
-    _stack.pop_back();
-    op2 = dynamic_cast<IOperand const*>(_stack.back());
-    _stack.pop_back();
+static_assert(static_cast<int>(OpCode::Add) != 0, "0 marks a leaf in LazyStack");
 
+/* Lazy mode: handles `instr` on the deferred values if it cannot fail
+ * and only touches them. Exit leaves them uncomputed, since nothing
+ * observes the stack after it. */
+bool vm::m_defer(const Instruction& instr, const ConstantPool& pool)
+{
+    eOperandType type;
+    OperandValue value;
+
+    if (_pending.full())
+        return false;
     switch (instr.op)
     {
+        case OpCode::Push:
+        {
+            const Constant& c = pool[instr.constant];
+            if (c.error.failed())
+                return false;
+            _pending.push(c.type, c.value);
+            MemStats::noteStackDepth(m_depth());
+            return true;
+        }
+        case OpCode::Pop:
+            if (_pending.empty())
+                return false;
+            _pending.pop();
+            return true;
         case OpCode::Add:
-            result = *op2 + *op1;
-            LOG_OP("Add result: " + result->toString(), instr.line);
-            break;
         case OpCode::Sub:
-            result = *op2 - *op1;
-            LOG_OP("Sub result: " + result->toString(), instr.line);
-            break;
         case OpCode::Mul:
-            result = *op2 * *op1;
-            LOG_OP("Mul result: " + result->toString(), instr.line);
-            break;
+            if (_pending.size() < 2 || _checked)
+                return false;
+            _pending.apply(static_cast<uint8_t>(instr.op), arith::promote(_pending.typeAt(1), _pending.typeAt(0)));
+            return true;
         case OpCode::Div:
-            result = *op2 / *op1;
-            LOG_OP("Div result: " + result->toString(), instr.line);
-            break;
         case OpCode::Mod:
-            result = *op2 % *op1;
-            LOG_OP("Mod result: " + result->toString(), instr.line);
-            break;
+            /* Only a divisor already known to be non-zero. */
+            if (_pending.size() < 2 || _checked || !_pending.known(0, type, value)
+                || arith::divisorIsZero(arith::opChar(m_arithOp(instr.op)), type, value))
+                return false;
+            _pending.apply(static_cast<uint8_t>(instr.op), arith::promote(_pending.typeAt(1), type));
+            return true;
+        case OpCode::Dup:
+            if (_pending.empty())
+                return false;
+            _pending.copyToTop(0);
+            MemStats::noteStackDepth(m_depth());
+            return true;
+        case OpCode::Swap:
+            if (_pending.size() < 2)
+                return false;
+            _pending.swap(0, 1);
+            return true;
+        case OpCode::Over:
+            if (_pending.size() < 2)
+                return false;
+            _pending.copyToTop(1);
+            MemStats::noteStackDepth(m_depth());
+            return true;
+        case OpCode::Rot:
+            if (_pending.size() < 3)
+                return false;
+            _pending.swap(2, 1);
+            _pending.swap(1, 0);
+            return true;
+        case OpCode::Exit:
+            _halted = true;
+            return true;
         default:
-            /* never */
-            break;
+            return false;
     }
+}
 
-    _stack.push_back(result);
-    delete op1;
-    delete op2;
+/* Computes the deferred values onto the stack, with the unchecked
+ * kernels performOperation uses. */
+void vm::m_materialize()
+{
+    if (_pending.empty())
+        return;
+    _pending.flush(_stack, [](uint8_t op, eOperandType lt, OperandValue lhs, eOperandType rt, OperandValue rhs,
+                              OperandValue& result) {
+        result = arith::kernelFor(lt, rt, m_arithOp(static_cast<OpCode>(op)))(lhs, rhs);
+    });
+    MemStats::noteStackDepth(_stack.size());
+}
+
+eOperandType vm::m_typeAt(size_t fromTop) const
+{
+    if (fromTop < _pending.size())
+        return _pending.typeAt(fromTop);
+    fromTop -= _pending.size();
+    return fromTop < _stack.size() ? _stack.typeAt(fromTop) : None;
 }
 
-void vm::executeInstruction(const Instruction& instr)
+Error vm::tryExecute(const Instruction& instr, const ConstantPool& pool)
 {
-    IOperand const* op1;
+    MemScope scope(MemSubsystem::Stack);
 
-    m_print_instruction(instr);
+    m_print_instruction(instr, pool);
+    Profiler::setLine(instr.line);
+    AVM_TRACE(static_cast<uint8_t>(instr.op), static_cast<uint32_t>(instr.line), static_cast<uint8_t>(m_typeAt(1)),
+              static_cast<uint8_t>(m_typeAt(0)), static_cast<uint32_t>(m_depth()));
+    if (_lazy)
+    {
+        if (m_defer(instr, pool))
+            return Error();
+        m_materialize();
+    }
     switch (instr.op)
     {
         case OpCode::Push:
-            LOG("Executing Push instruction.");
-            _stack.push_back(OperandFactory::createOperand(instr.arg->type, instr.arg->literal));
+        {
+            const Constant& c = pool[instr.constant];
+            if (c.error.failed())
+                return c.error;
+            _stack.push(c.type, c.value);
+            MemStats::noteStackDepth(_stack.size());
             break;
+        }
         case OpCode::Pop:
-            LOG("Executing Pop instruction.");
             if (!_stack.empty())
-            {
-                delete _stack.back();
-                _stack.pop_back();
-            }
+                _stack.pop();
             else
-                throw StackUnderflow(instr.line, "Pop on empty stack");
+                return Error(m_popEmpty, instr.line);
             break;
         case OpCode::Dump:
-            LOG("Executing Dump instruction.");
-            for (auto it = _stack.rbegin(); it != _stack.rend(); ++it)
-                std::cout << (*it)->toString() << std::endl;
-
+            MemStats::setCurrent(MemSubsystem::Output);
+            _stack.dump(_out, _jobs);
             break;
         case OpCode::Assert:
-            LOG("Executing Assert instruction.");
-            op1 = dynamic_cast<IOperand const*>(_stack.back());
+            if (_stack.empty())
+                return Error(m_assertEmpty, instr.line);
             {
-                IOperand const* expected = OperandFactory::createOperand(instr.arg->type, instr.arg->literal);
-                if (op1->getType() != expected->getType() || op1->toString() != expected->toString())
+                const Constant& expected = pool[instr.constant];
+                if (expected.error.failed())
+                    return expected.error;
+                if (_stack.typeAt(0) != expected.type
+                    || !m_sameCanonical(expected.type, _stack.valueAt(0), expected.value))
                 {
-                    delete expected;
-                    throw AssertionFailed(instr.line, "Assertion failed");
+                    return Error(m_assertFailed, instr.line);
                 }
-                delete expected;
             }
             break;
         case OpCode::Add:
-            LOG("Executing Add instruction.");
-            this->performOperation(instr);
-            break;
+            return this->performOperation(instr);
         case OpCode::Sub:
-            LOG("Executing Sub instruction.");
-            this->performOperation(instr);
-            break;
+            return this->performOperation(instr);
         case OpCode::Mul:
-            LOG("Executing Mul instruction.");
-            this->performOperation(instr);
-            break;
+            return this->performOperation(instr);
         case OpCode::Div:
-            LOG("Executing Div instruction.");
-            this->performOperation(instr);
-            break;
+            return this->performOperation(instr);
         case OpCode::Mod:
-            LOG("Executing Mod instruction.");
-            this->performOperation(instr);
+            return this->performOperation(instr);
+        case OpCode::Sum:
+        case OpCode::Prod:
+        case OpCode::Min:
+        case OpCode::Max:
+            return this->performReduction(instr, pool[instr.constant]);
+        case OpCode::Dup:
+            if (_stack.empty())
+                return Error(m_dupEmpty, instr.line);
+            _stack.copyToTop(0);
+            MemStats::noteStackDepth(_stack.size());
+            break;
+        case OpCode::Swap:
+            if (_stack.size() < 2)
+                return Error(m_swapUnderflow, instr.line);
+            _stack.swap(0, 1);
+            break;
+        case OpCode::Over:
+            if (_stack.size() < 2)
+                return Error(m_overUnderflow, instr.line);
+            _stack.copyToTop(1);
+            MemStats::noteStackDepth(_stack.size());
             break;
+        case OpCode::Rot:
+            /* a b c -> b c a (c on top): the third value moves to the top. */
+            if (_stack.size() < 3)
+                return Error(m_rotUnderflow, instr.line);
+            _stack.swap(2, 1);
+            _stack.swap(1, 0);
+            break;
+        case OpCode::Load:
+            return this->performLoad(instr, pool[instr.constant]);
         case OpCode::Print:
-            LOG("Executing Print instruction.");
+            MemStats::setCurrent(MemSubsystem::Output);
             if (_stack.empty())
-                throw StackUnderflow(instr.line, "Print on empty stack");
+                return Error(m_printEmpty, instr.line);
 
+            if (_stack.typeAt(0) != Int8)
             {
-                IOperand const* top = _stack.back();
-                if (top->getType() != Int8)
-                {
-                    throw AssertionFailed(instr.line, "Print instruction requires top of stack to be Int8");
-                }
-                char c = static_cast<char>(std::stoi(top->toString()));
-                std::cout << c << std::endl;
+                return Error(m_printNotInt8, instr.line);
             }
+            _out << static_cast<char>(_stack.valueAt(0).i) << '\n';
             break;
         case OpCode::Exit:
-            LOG("Executing Exit instruction.");
-            exit(0);
+            _halted = true;
             break;
+        case OpCode::Label:
+            break;
+        case OpCode::Fault:
+            /* A line that failed to lex, parse or link, reported when reached. */
+            return pool[instr.constant].error;
         default:
             LOG("Unknown instruction.");
             break;
     }
+    return Error();
 }
 
-vm::vm()
+vm::vm(std::ostream& out) : _loadLimit(kDefaultLoadLimit), _out(out), _halted(false), _checked(false), _lazy(false), _jobs(0)
 {
 }
 
 vm::~vm()
 {
-    for (auto operand : _stack)
-    {
-        delete operand;
-    }
 }
@@ -1,33 +1,150 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <optional>
+#include <iostream>
 #include "../operand/IOperand.hpp"
 #include "../operand/OperandFactory.hpp"
+#include "OperandStack.hpp"
+#include "LazyStack.hpp"
+#include "ConstantPool.hpp"
 
-enum class OpCode { Push, Pop, Dump, Assert, Add, Sub, Mul, Div, Mod, Print, Exit, None };
+enum class OpCode { Push, Pop, Dump, Assert, Add, Sub, Mul, Div, Mod, Print, Exit,
+                    Sum, Prod, Min, Max, Dup, Swap, Over, Rot, Load,
+                    Label, Jmp, Jz, Jnz, Repeat, End, Fault, None };
 
-struct OpValue { eOperandType type; std::string literal; };
+inline const char* opName(OpCode op)
+{
+    switch (op)
+    {
+        case OpCode::Push: return "Push";
+        case OpCode::Pop: return "Pop";
+        case OpCode::Dump: return "Dump";
+        case OpCode::Assert: return "Assert";
+        case OpCode::Add: return "Add";
+        case OpCode::Sub: return "Sub";
+        case OpCode::Mul: return "Mul";
+        case OpCode::Div: return "Div";
+        case OpCode::Mod: return "Mod";
+        case OpCode::Print: return "Print";
+        case OpCode::Exit: return "Exit";
+        case OpCode::Sum: return "Sum";
+        case OpCode::Prod: return "Prod";
+        case OpCode::Min: return "Min";
+        case OpCode::Max: return "Max";
+        case OpCode::Dup: return "Dup";
+        case OpCode::Swap: return "Swap";
+        case OpCode::Over: return "Over";
+        case OpCode::Rot: return "Rot";
+        case OpCode::Load: return "Load";
+        case OpCode::Label: return "Label";
+        case OpCode::Jmp: return "Jmp";
+        case OpCode::Jz: return "Jz";
+        case OpCode::Jnz: return "Jnz";
+        case OpCode::Repeat: return "Repeat";
+        case OpCode::End: return "End";
+        case OpCode::Fault: return "Fault";
+        case OpCode::None: return "None";
+    }
+    return "Unknown";
+}
+
+/* `constant` indexes the ConstantPool the instruction was parsed into,
+ * or is ConstantPool::kNone for instructions without a value. Label and
+ * jump names are constants too. `target` is filled in by the Assembler:
+ * the label a jump goes to, the instruction after a repeat's end, or the
+ * repeat an end loops back to. */
 struct Instruction {
+    static constexpr size_t kUnlinked = SIZE_MAX;
+
     int line;
     OpCode op;
-    std::optional<OpValue> arg;
+    uint32_t constant;
+    size_t target = kUnlinked;
+};
+
+/* Binary input for `load <type> "<path>"`: either a raw little-endian
+ * array of the element type, or this 16-byte header followed by one.
+ * A header's type must match the instruction's type. */
+struct LoadFileHeader
+{
+    char magic[4];      /* "AVMB" */
+    uint8_t version;    /* 1 */
+    uint8_t type;       /* eOperandType */
+    uint16_t reserved;
+    uint64_t count;
 };
 
 class vm
 {
     private:
-        std::vector<IOperand const *> _stack;
+        static constexpr size_t kDefaultLoadLimit = size_t(1) << 30;
+
+        OperandStack _stack;
+        size_t _loadLimit;
+        std::ostream& _out;
+        bool _halted;
+        bool _checked;
+        bool _lazy;
+        unsigned _jobs;
+        LazyStack _pending;
 
-        void performOperation(const Instruction& instr);
+        Error performOperation(const Instruction& instr);
+        Error performReduction(const Instruction& instr, const Constant& countArg);
+        Error performLoad(const Instruction& instr, const Constant& source);
+        bool m_defer(const Instruction& instr, const ConstantPool& pool);
+        void m_materialize();
+        /* Depth and types as an eager run would see them, deferred
+         * values included; None past the bottom. */
+        size_t m_depth() const { return _stack.size() + _pending.size(); }
+        eOperandType m_typeAt(size_t fromTop) const;
 
         vm(const vm& other);
         const vm& operator=(const vm& other);
 
     public:
-        vm();
+        /* All program output (dump, print) goes to `out`; a vm keeps no
+         * other global state, so one instance per thread is safe. */
+        explicit vm(std::ostream& out = std::cout);
         ~vm();
-        void executeInstruction(const Instruction& instr);
+        /* Runs one instruction whose constant lives in `pool`; on failure
+         * the stack is left as it was before it, so the caller may report
+         * the Error and go on. */
+        Error tryExecute(const Instruction& instr, const ConstantPool& pool);
+        /* Same, throwing the matching AVMException. */
+        void executeInstruction(const Instruction& instr, const ConstantPool& pool);
+        /* Pops the top value for jz/jnz; `zero` tells whether it was 0. */
+        Error popCondition(const Instruction& instr, bool& zero);
+        /* True once an exit instruction has executed. */
+        bool halted() const { return _halted; }
+        void setLoadLimit(size_t bytes) { _loadLimit = bytes; }
+        /* Report integer results that leave their type's range instead
+         * of wrapping them. */
+        void setCheckedArithmetic(bool checked) { _checked = checked; }
+        bool checkedArithmetic() const { return _checked; }
+        /* Defer arithmetic that cannot fail until its value is observed:
+         * by dump, assert, print, a jump condition, an instruction that
+         * could fail or that reaches below the deferred values. Results
+         * that are popped first are never computed. Output and errors are
+         * those of an eager run. */
+        void setLazy(bool lazy) { _lazy = lazy; }
+        /* Threads a dump of a large stack may use, 0 for every core. A vm
+         * that runs beside others on a pool of its own should use 1. */
+        void setJobs(unsigned jobs) { _jobs = jobs; }
+        /* Where dump and print write. */
+        std::ostream& output() { return _out; }
+        /* See OperandStack::setMemoryBudget. */
+        void setStackMemoryBudget(size_t bytes) { _stack.setMemoryBudget(bytes); }
+        /* For checkpoints: saved as is, restored into an empty vm. The
+         * const one holds no deferred values; the other computes them. */
+        const OperandStack& stack() const { return _stack; }
+        OperandStack& stack()
+        {
+            m_materialize();
+            return _stack;
+        }
 
 };
 
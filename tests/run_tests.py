@@ -1,12 +1,16 @@
 #!/usr/bin/env python3
 import subprocess
 import sys
+import tempfile
 from pathlib import Path
 
 BIN = Path(__file__).resolve().parents[1] / "abstract_vm"
 TESTS_DIR = Path(__file__).resolve().parent
 
+DECODER = BIN.with_name("avm_trace_decode")
+
 STDIN_DIR = TESTS_DIR / "stdin"
+TRACE_DIR = TESTS_DIR / "trace"
 
 
 def ensure_stdin_terminator(src: str) -> str:
@@ -62,21 +66,47 @@ def check_expected(avm_path: Path, stdout: str, stderr: str, code: int):
     return False, "No expected .out or .err file found for this test"
 
 
+def extra_args(avm_path: Path):
+    # Optional <name>.args: extra command line options, paths relative to tests/
+    args_path = avm_path.with_suffix(".args")
+    if not args_path.exists():
+        return []
+    return args_path.read_text().split()
+
+
 def run_one_file_mode(avm_path: Path):
-    proc = run_process([str(BIN), str(avm_path)])
+    proc = run_process([str(BIN)] + extra_args(avm_path) + [str(avm_path)])
     return check_expected(avm_path, proc.stdout, proc.stderr, proc.returncode)
 
 
 def run_one_stdin_mode(avm_path: Path):
     src = avm_path.read_text()
     stdin_payload = ensure_stdin_terminator(src)
-    proc = run_process([str(BIN)], stdin_text=stdin_payload)
+    proc = run_process([str(BIN)] + extra_args(avm_path), stdin_text=stdin_payload)
     return check_expected(avm_path, proc.stdout, proc.stderr, proc.returncode)
 
 
+def run_one_trace_mode(avm_path: Path):
+    # --trace, then avm_trace_decode; the text must match <name>.trace
+    with tempfile.TemporaryDirectory() as tmp:
+        trace = Path(tmp) / "run.trace"
+        proc = run_process([str(BIN)] + extra_args(avm_path) + ["--trace", str(trace), str(avm_path)])
+        if proc.returncode != 0:
+            return False, f"Expected exit code 0, got {proc.returncode}\nStderr:\n{proc.stderr}"
+        decoded = run_process([str(DECODER), str(trace)])
+    expected = avm_path.with_suffix(".trace").read_text()
+    if decoded.returncode != 0 or decoded.stdout != expected:
+        return False, (
+            "Decoded trace mismatch\n"
+            f"--- expected ({avm_path.with_suffix('.trace').name}) ---\n{expected}\n"
+            f"--- got ---\n{decoded.stdout}{decoded.stderr}\n"
+        )
+    return True, "OK"
+
+
 def collect_file_tests():
     avms = sorted(TESTS_DIR.rglob("*.avm"))
-    return [p for p in avms if p.is_file() and STDIN_DIR not in p.parents]
+    return [p for p in avms if p.is_file() and STDIN_DIR not in p.parents and TRACE_DIR not in p.parents]
 
 
 def collect_stdin_tests():
@@ -85,6 +115,12 @@ def collect_stdin_tests():
     return sorted([p for p in STDIN_DIR.rglob("*.avm") if p.is_file()])
 
 
+def collect_trace_tests():
+    if not TRACE_DIR.exists():
+        return []
+    return sorted([p for p in TRACE_DIR.rglob("*.avm") if p.is_file()])
+
+
 def main():
     if not BIN.exists():
         print(f"Binary not found: {BIN}", file=sys.stderr)
@@ -92,6 +128,7 @@ def main():
 
     file_tests = collect_file_tests()
     stdin_tests = collect_stdin_tests()
+    trace_tests = collect_trace_tests()
 
     if not file_tests and not stdin_tests:
         print("No tests found.", file=sys.stderr)
@@ -121,6 +158,17 @@ def main():
             failed += 1
             print(f"\033[1;31m[FAIL] {label}\n{msg}\033[0m")
 
+    for t in trace_tests:
+        total += 1
+        ok, msg = run_one_trace_mode(t)
+        rel = t.relative_to(TESTS_DIR)
+        label = f"{rel} (trace)"
+        if ok:
+            print(f"\033[1;32m[PASS] {label}\033[0m")
+        else:
+            failed += 1
+            print(f"\033[1;31m[FAIL] {label}\n{msg}\033[0m")
+
     print(f"\nSummary: {total - failed}/{total} passed")
     return 0 if failed == 0 else 1
 